@@ -0,0 +1,268 @@
+//
+// SizeBasedArena.h
+//
+
+#ifndef SIZE_BASED_ARENA_H
+#define SIZE_BASED_ARENA_H
+
+#include <cassert>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <span>
+#include <utility>
+#include <type_traits>
+
+template <class T, std::size_t N>
+class SizeBasedArena {
+   static_assert(std::is_final_v<T>);
+   // released slots are reused through an intrusive free list
+   // threaded through the slots themselves, hence:
+   static_assert(sizeof(T) >= sizeof(void*) && alignof(T) >= alignof(void*));
+   struct free_slot {
+      free_slot *next;
+   };
+   // released spans of two slots or more (from allocate_n) are
+   // kept in their own list; single-slot spans join the slot list
+   struct free_span {
+      free_span *next;
+      std::size_t n;
+   };
+   // the nodes of both lists are placed in released slots, sizeof(T)
+   // bytes apart from the (max-aligned) start of the memory; a span
+   // covers two slots or more, hence:
+   static_assert(2 * sizeof(T) >= sizeof(free_span));
+   static_assert(alignof(T) >= alignof(free_span));
+   std::mutex m;
+   char *p, *cur;
+   free_slot *slots = nullptr;
+   free_span *spans = nullptr;
+   SizeBasedArena()
+      : p{ static_cast<char*>(std::malloc(N * sizeof(T))) } {
+      assert(p);
+      cur = p;
+   }
+   SizeBasedArena(const SizeBasedArena&) = delete;
+   SizeBasedArena& operator=(const SizeBasedArena&) = delete;
+   // precondition: m is locked
+   void * bump(std::size_t n) {
+      if (static_cast<std::size_t>(p + N * sizeof(T) - cur) < n * sizeof(T))
+         throw std::bad_alloc{};
+      auto q = cur;
+      cur += n * sizeof(T);
+      return q;
+   }
+   // precondition: m is locked
+   void push_slot(void *q) noexcept {
+      slots = ::new (q) free_slot{ slots };
+   }
+public:
+   ~SizeBasedArena() {
+      std::free(p);
+   }
+   static auto &get() {
+      static SizeBasedArena singleton;
+      return singleton;
+   }
+   void * allocate_one() {
+      std::lock_guard _ { m };
+      if (slots)
+         return std::exchange(slots, slots->next);
+      return bump(1);
+   }
+   void * allocate_n(std::size_t n) {
+      if (n == 1) return allocate_one();
+      std::lock_guard _ { m };
+      // first fit; what remains of the span stays available
+      for (auto pp = &spans; *pp; pp = &(*pp)->next) {
+         if (auto s = *pp; s->n >= n) {
+            auto q = reinterpret_cast<char*>(s);
+            auto rest = s->n - n;
+            *pp = s->next;
+            if (rest == 1)
+               push_slot(q + n * sizeof(T));
+            else if (rest > 1)
+               *pp = ::new (q + n * sizeof(T)) free_span{ *pp, rest };
+            return q;
+         }
+      }
+      return bump(n);
+   }
+   void deallocate_one(void *q) noexcept {
+      if (!q) return;
+      std::lock_guard _ { m };
+      push_slot(q);
+   }
+   void deallocate_n(void *q, std::size_t n) noexcept {
+      if (!q) return;
+      if (n == 1) return deallocate_one(q);
+      std::lock_guard _ { m };
+      spans = ::new (q) free_span{ spans, n };
+   }
+   //
+   // batch versions of allocate_one() and deallocate_one(): one
+   // lock for the whole batch. allocate_batch() fills out with
+   // storage for size(out) objects, or throws and fills nothing
+   //
+   void allocate_batch(std::span<T*> out) {
+      std::lock_guard _ { m };
+      auto q = std::begin(out);
+      for (; q != std::end(out) && slots; ++q)
+         *q = reinterpret_cast<T*>(std::exchange(slots, slots->next));
+      auto rest = static_cast<std::size_t>(std::end(out) - q);
+      if (static_cast<std::size_t>(p + N * sizeof(T) - cur) < rest * sizeof(T)) {
+         // give back what was taken
+         while (q != std::begin(out))
+            push_slot(*--q);
+         throw std::bad_alloc{};
+      }
+      for (; q != std::end(out); ++q)
+         *q = reinterpret_cast<T*>(bump(1));
+   }
+   void deallocate_batch(std::span<T* const> in) noexcept {
+      std::lock_guard _ { m };
+      for (auto q : in)
+         if (q) push_slot(q);
+   }
+};
+
+#endif
+
+
+//
+// Orc.h
+//
+
+#ifndef ORC_H
+#define ORC_H
+
+#define HOMEMADE_VERSION
+
+#include <cstddef>
+#include <new>
+#include <span>
+
+class Orc final {
+   char name[4]{ 'U', 'R', 'G' };
+   int strength = 100;
+   double smell = 1000.0;
+public:
+   static constexpr int NB_MAX = 1'000'000;
+#ifdef HOMEMADE_VERSION
+   void * operator new(std::size_t);
+   void * operator new[](std::size_t);
+   void operator delete(void *) noexcept;
+   void operator delete[](void *, std::size_t) noexcept;
+   // as many new Orc as size(out), stored in out
+   static void new_batch(std::span<Orc*> out);
+   // delete for each Orc in orcs
+   static void delete_batch(std::span<Orc* const> orcs) noexcept;
+#endif
+};
+
+#endif
+
+//
+// Orc.cpp
+//
+// #include "Orc.h"
+
+#ifdef HOMEMADE_VERSION
+
+// #include "SizeBasedArena.h"
+
+using Tribe = SizeBasedArena<Orc, Orc::NB_MAX>;
+       
+void * Orc::operator new(std::size_t) {
+   return Tribe::get().allocate_one();
+}
+// with a sized operator delete[], n includes the array cookie
+static constexpr std::size_t nb_orcs(std::size_t n) {
+   return (n + sizeof(Orc) - 1) / sizeof(Orc);
+}
+void * Orc::operator new[](std::size_t n) {
+   return Tribe::get().allocate_n(nb_orcs(n));
+}
+void Orc::operator delete(void *p) noexcept {
+   Tribe::get().deallocate_one(p);
+}
+void Orc::operator delete[](void *p, std::size_t n) noexcept {
+   Tribe::get().deallocate_n(p, nb_orcs(n));
+}
+void Orc::new_batch(std::span<Orc*> out) {
+   Tribe::get().allocate_batch(out);
+   for (auto &p : out)
+      p = ::new (p) Orc; // Orc's constructor cannot throw
+}
+void Orc::delete_batch(std::span<Orc* const> orcs) noexcept {
+   for (auto p : orcs)
+      if (p) p->~Orc();
+   Tribe::get().deallocate_batch(orcs);
+}
+
+#endif
+
+//
+// Test program
+//
+// #include "Orc.h"
+
+#include <chrono>
+#include <utility>
+
+template <class F, class ... Args>
+   auto test(F f, Args &&... args) {
+      using namespace std;
+      using namespace std::chrono;
+      auto pre = high_resolution_clock::now();
+      auto res = f(std::forward<Args>(args)...);
+      auto post = high_resolution_clock::now();
+      return pair{ res, post - pre };
+   }
+
+#include <print>
+#include <vector>
+int main() {
+   using namespace std;
+   using namespace std::chrono;
+#ifdef HOMEMADE_VERSION
+   print("HOMEMADE VERSION\n");
+#else
+   print("STANDARD LIBRARY VERSION\n");
+#endif
+   vector<Orc*> orcs;
+   orcs.reserve(Orc::NB_MAX);
+   auto [r0, dt0] = test([&orcs] {
+      for(int i = 0; i != Orc::NB_MAX; ++i)
+         orcs.push_back(new Orc);
+      return size(orcs);
+   });
+   // ...
+   // CARNAGE (CENSORED)
+   // ...
+   auto [r1, dt1] = test([&orcs] {
+      for(auto p : orcs)
+         delete p;
+      return size(orcs);
+   });
+   print("Construction: {} orcs in {}\n", size(orcs), duration_cast<microseconds>(dt0));
+   print("Destruction:  {} orcs in {}\n", size(orcs), duration_cast<microseconds>(dt1));
+#ifdef HOMEMADE_VERSION
+   //
+   // same, with the whole tribe created then killed in one batch
+   //
+   auto [r2, dt2] = test([&orcs] {
+      Orc::new_batch(orcs);
+      return size(orcs);
+   });
+   // ...
+   // CARNAGE (CENSORED)
+   // ...
+   auto [r3, dt3] = test([&orcs] {
+      Orc::delete_batch(orcs);
+      return size(orcs);
+   });
+   print("Batch construction: {} orcs in {}\n", size(orcs), duration_cast<microseconds>(dt2));
+   print("Batch destruction:  {} orcs in {}\n", size(orcs), duration_cast<microseconds>(dt3));
+#endif
+}
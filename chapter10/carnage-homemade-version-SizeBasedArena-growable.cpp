@@ -0,0 +1,262 @@
+//
+// SizeBasedArena.h
+//
+
+#ifndef SIZE_BASED_ARENA_H
+#define SIZE_BASED_ARENA_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <type_traits>
+
+//
+// growth policies: given the capacity (in objects) of the
+// last slab, tell how big the next one should be
+//
+struct fixed_growth {
+   static constexpr std::size_t next(std::size_t n) { return n; }
+};
+struct geometric_growth {
+   static constexpr std::size_t next(std::size_t n) { return 2 * n; }
+};
+
+//
+// the arena is a chain of slabs, the first one holding N objects;
+// when the current slab is full, a new one is obtained (its capacity
+// given by Growth), and all slabs are released at destruction time.
+// If Lazy, the first slab is only obtained on the first allocation
+//
+template <class T, std::size_t N, class Growth = geometric_growth, bool Lazy = true>
+class SizeBasedArena {
+   static_assert(std::is_final_v<T>);
+   static_assert(N > 0);
+   static_assert(alignof(T) <= alignof(std::max_align_t));
+   // released slots are reused through an intrusive free list
+   // threaded through the slots themselves, hence:
+   static_assert(sizeof(T) >= sizeof(void*) && alignof(T) >= alignof(void*));
+   struct free_slot {
+      free_slot *next;
+   };
+   // released spans of two slots or more (from allocate_n) are
+   // kept in their own list; single-slot spans join the slot list
+   struct free_span {
+      free_span *next;
+      std::size_t n;
+   };
+   // the nodes of both lists are placed in released slots, sizeof(T)
+   // bytes apart from the (max-aligned) start of the memory; a span
+   // covers two slots or more, hence:
+   static_assert(2 * sizeof(T) >= sizeof(free_span));
+   static_assert(alignof(T) >= alignof(free_span));
+   // each slab starts with this header, followed by its objects
+   struct slab {
+      slab *prev;
+      std::size_t n;
+   };
+   static constexpr std::size_t header_size =
+      (sizeof(slab) + alignof(T) - 1) / alignof(T) * alignof(T);
+   std::mutex m;
+   slab *last = nullptr;
+   char *cur = nullptr, *end = nullptr;
+   free_slot *slots = nullptr;
+   free_span *spans = nullptr;
+   std::size_t nslabs = 0;
+   SizeBasedArena() {
+      if constexpr (!Lazy)
+         add_slab(N);
+   }
+   SizeBasedArena(const SizeBasedArena&) = delete;
+   SizeBasedArena& operator=(const SizeBasedArena&) = delete;
+   // precondition: m is locked
+   void push_slot(void *q) noexcept {
+      slots = ::new (q) free_slot{ slots };
+   }
+   // precondition: m is locked
+   void push_span(void *q, std::size_t n) noexcept {
+      if (n == 1)
+         push_slot(q);
+      else if (n > 1)
+         spans = ::new (q) free_span{ spans, n };
+   }
+   // precondition: m is locked
+   void add_slab(std::size_t n) {
+      auto s = static_cast<slab*>(std::malloc(header_size + n * sizeof(T)));
+      if (!s) throw std::bad_alloc{};
+      // what remains of the current slab stays available
+      push_span(cur, (end - cur) / sizeof(T));
+      last = ::new (s) slab{ last, n };
+      cur = reinterpret_cast<char*>(s) + header_size;
+      end = cur + n * sizeof(T);
+      ++nslabs;
+   }
+   // precondition: m is locked
+   void * bump(std::size_t n) {
+      if (static_cast<std::size_t>(end - cur) < n * sizeof(T))
+         add_slab(std::max(last ? Growth::next(last->n) : N, n));
+      return std::exchange(cur, cur + n * sizeof(T));
+   }
+public:
+   ~SizeBasedArena() {
+      while (last)
+         std::free(std::exchange(last, last->prev));
+   }
+   static auto &get() {
+      static SizeBasedArena singleton;
+      return singleton;
+   }
+   std::size_t nb_slabs() {
+      std::lock_guard _ { m };
+      return nslabs;
+   }
+   void * allocate_one() {
+      std::lock_guard _ { m };
+      if (slots)
+         return std::exchange(slots, slots->next);
+      return bump(1);
+   }
+   void * allocate_n(std::size_t n) {
+      if (n == 1) return allocate_one();
+      std::lock_guard _ { m };
+      // first fit; what remains of the span stays available
+      for (auto pp = &spans; *pp; pp = &(*pp)->next) {
+         if (auto s = *pp; s->n >= n) {
+            auto q = reinterpret_cast<char*>(s);
+            auto rest = s->n - n;
+            *pp = s->next;
+            if (rest == 1)
+               push_slot(q + n * sizeof(T));
+            else if (rest > 1)
+               *pp = ::new (q + n * sizeof(T)) free_span{ *pp, rest };
+            return q;
+         }
+      }
+      return bump(n);
+   }
+   void deallocate_one(void *q) noexcept {
+      if (!q) return;
+      std::lock_guard _ { m };
+      push_slot(q);
+   }
+   void deallocate_n(void *q, std::size_t n) noexcept {
+      if (!q) return;
+      std::lock_guard _ { m };
+      push_span(q, n);
+   }
+};
+
+#endif
+
+
+//
+// Orc.h
+//
+
+#ifndef ORC_H
+#define ORC_H
+
+#define HOMEMADE_VERSION
+
+#include <cstddef>
+#include <new>
+
+class Orc final {
+   char name[4]{ 'U', 'R', 'G' };
+   int strength = 100;
+   double smell = 1000.0;
+public:
+   static constexpr int NB_MAX = 1'000'000;
+   // capacity of the first slab, in orcs
+   static constexpr int NB_FIRST = 1'024;
+#ifdef HOMEMADE_VERSION
+   void * operator new(std::size_t);
+   void * operator new[](std::size_t);
+   void operator delete(void *) noexcept;
+   void operator delete[](void *, std::size_t) noexcept;
+#endif
+};
+
+#endif
+
+//
+// Orc.cpp
+//
+// #include "Orc.h"
+
+#ifdef HOMEMADE_VERSION
+
+// #include "SizeBasedArena.h"
+
+using Tribe = SizeBasedArena<Orc, Orc::NB_FIRST, geometric_growth>;
+
+void * Orc::operator new(std::size_t) {
+   return Tribe::get().allocate_one();
+}
+// with a sized operator delete[], n includes the array cookie
+static constexpr std::size_t nb_orcs(std::size_t n) {
+   return (n + sizeof(Orc) - 1) / sizeof(Orc);
+}
+void * Orc::operator new[](std::size_t n) {
+   return Tribe::get().allocate_n(nb_orcs(n));
+}
+void Orc::operator delete(void *p) noexcept {
+   Tribe::get().deallocate_one(p);
+}
+void Orc::operator delete[](void *p, std::size_t n) noexcept {
+   Tribe::get().deallocate_n(p, nb_orcs(n));
+}
+
+#endif
+
+//
+// Test program
+//
+// #include "Orc.h"
+
+#include <chrono>
+#include <utility>
+
+template <class F, class ... Args>
+   auto test(F f, Args &&... args) {
+      using namespace std;
+      using namespace std::chrono;
+      auto pre = high_resolution_clock::now();
+      auto res = f(std::forward<Args>(args)...);
+      auto post = high_resolution_clock::now();
+      return pair{ res, post - pre };
+   }
+
+#include <print>
+#include <vector>
+int main() {
+   using namespace std;
+   using namespace std::chrono;
+#ifdef HOMEMADE_VERSION
+   print("HOMEMADE VERSION\n");
+#else
+   print("STANDARD LIBRARY VERSION\n");
+#endif
+   vector<Orc*> orcs;
+   orcs.reserve(Orc::NB_MAX);
+   auto [r0, dt0] = test([&orcs] {
+      for(int i = 0; i != Orc::NB_MAX; ++i)
+         orcs.push_back(new Orc);
+      return size(orcs);
+   });
+   // ...
+   // CARNAGE (CENSORED)
+   // ...
+   auto [r1, dt1] = test([&orcs] {
+      for(auto p : orcs)
+         delete p;
+      return size(orcs);
+   });
+   print("Construction: {} orcs in {}\n", size(orcs), duration_cast<microseconds>(dt0));
+   print("Destruction:  {} orcs in {}\n", size(orcs), duration_cast<microseconds>(dt1));
+#ifdef HOMEMADE_VERSION
+   print("Slabs:        {}\n", Tribe::get().nb_slabs());
+#endif
+}
@@ -0,0 +1,295 @@
+//
+// SizeBasedArena.h
+//
+
+#ifndef SIZE_BASED_ARENA_H
+#define SIZE_BASED_ARENA_H
+
+// comment out to go through the arena's mutex for every allocation
+#define USE_MAGAZINES
+
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <type_traits>
+
+template <class T, std::size_t N>
+class SizeBasedArena {
+   static_assert(std::is_final_v<T>);
+   // released slots are reused through an intrusive free list
+   // threaded through the slots themselves, hence:
+   static_assert(sizeof(T) >= sizeof(void*) && alignof(T) >= alignof(void*));
+   struct free_slot {
+      free_slot *next;
+   };
+   // released spans of two slots or more (from allocate_n) are
+   // kept in their own list; single-slot spans join the slot list
+   struct free_span {
+      free_span *next;
+      std::size_t n;
+   };
+   // the nodes of both lists are placed in released slots, sizeof(T)
+   // bytes apart from the (max-aligned) start of the memory; a span
+   // covers two slots or more, hence:
+   static_assert(2 * sizeof(T) >= sizeof(free_span));
+   static_assert(alignof(T) >= alignof(free_span));
+   std::mutex m;
+   char *p, *cur;
+   free_slot *slots = nullptr;
+   free_span *spans = nullptr;
+   SizeBasedArena()
+      : p{ static_cast<char*>(std::malloc(N * sizeof(T))) } {
+      assert(p);
+      cur = p;
+   }
+   SizeBasedArena(const SizeBasedArena&) = delete;
+   SizeBasedArena& operator=(const SizeBasedArena&) = delete;
+   // precondition: m is locked
+   void * bump(std::size_t n) {
+      if (static_cast<std::size_t>(p + N * sizeof(T) - cur) < n * sizeof(T))
+         throw std::bad_alloc{};
+      auto q = cur;
+      cur += n * sizeof(T);
+      return q;
+   }
+   // precondition: m is locked
+   void push_slot(void *q) noexcept {
+      slots = ::new (q) free_slot{ slots };
+   }
+   //
+   // moves up to n slots to out under a single lock, taking from
+   // the free list first, then from the untouched part of the block;
+   // returns how many slots were obtained
+   //
+   std::size_t refill(void **out, std::size_t n) {
+      std::lock_guard _ { m };
+      std::size_t k = 0;
+      for (; k != n && slots; ++k)
+         out[k] = std::exchange(slots, slots->next);
+      auto avail = static_cast<std::size_t>(p + N * sizeof(T) - cur) / sizeof(T);
+      for (auto i = std::min(n - k, avail); i != 0; --i, ++k) {
+         out[k] = cur;
+         cur += sizeof(T);
+      }
+      return k;
+   }
+   // gives n slots back under a single lock
+   void flush(void **in, std::size_t n) noexcept {
+      std::lock_guard _ { m };
+      for (std::size_t i = 0; i != n; ++i)
+         push_slot(in[i]);
+   }
+#ifdef USE_MAGAZINES
+   //
+   // per-thread cache of free slots; allocate_one and deallocate_one
+   // only touch the arena (and its mutex) when the magazine runs empty
+   // or full, and then transfer half a magazine at a time
+   //
+   class magazine {
+      static constexpr std::size_t CAPACITY = 128;
+      void *rounds[CAPACITY];
+      std::size_t n = 0;
+   public:
+      magazine() = default;
+      magazine(const magazine&) = delete;
+      magazine& operator=(const magazine&) = delete;
+      // a thread that ends gives its cached slots back
+      ~magazine() {
+         get().flush(rounds, n);
+      }
+      void * pop() {
+         if (n == 0) {
+            n = get().refill(rounds, CAPACITY / 2);
+            if (n == 0) throw std::bad_alloc{};
+         }
+         return rounds[--n];
+      }
+      void push(void *q) noexcept {
+         if (n == CAPACITY) {
+            n -= CAPACITY / 2;
+            get().flush(rounds + n, CAPACITY / 2);
+         }
+         rounds[n++] = q;
+      }
+   };
+   static inline thread_local magazine mag;
+#endif
+public:
+   ~SizeBasedArena() {
+      std::free(p);
+   }
+   static auto &get() {
+      static SizeBasedArena singleton;
+      return singleton;
+   }
+   void * allocate_one() {
+#ifdef USE_MAGAZINES
+      return mag.pop();
+#else
+      std::lock_guard _ { m };
+      if (slots)
+         return std::exchange(slots, slots->next);
+      return bump(1);
+#endif
+   }
+   void * allocate_n(std::size_t n) {
+      if (n == 1) return allocate_one();
+      std::lock_guard _ { m };
+      // first fit; what remains of the span stays available
+      for (auto pp = &spans; *pp; pp = &(*pp)->next) {
+         if (auto s = *pp; s->n >= n) {
+            auto q = reinterpret_cast<char*>(s);
+            auto rest = s->n - n;
+            *pp = s->next;
+            if (rest == 1)
+               push_slot(q + n * sizeof(T));
+            else if (rest > 1)
+               *pp = ::new (q + n * sizeof(T)) free_span{ *pp, rest };
+            return q;
+         }
+      }
+      return bump(n);
+   }
+   void deallocate_one(void *q) noexcept {
+      if (!q) return;
+#ifdef USE_MAGAZINES
+      mag.push(q);
+#else
+      std::lock_guard _ { m };
+      push_slot(q);
+#endif
+   }
+   void deallocate_n(void *q, std::size_t n) noexcept {
+      if (!q) return;
+      if (n == 1) return deallocate_one(q);
+      std::lock_guard _ { m };
+      spans = ::new (q) free_span{ spans, n };
+   }
+};
+
+#endif
+
+
+//
+// Orc.h
+//
+
+#ifndef ORC_H
+#define ORC_H
+
+#define HOMEMADE_VERSION
+
+#include <cstddef>
+#include <new>
+
+class Orc final {
+   char name[4]{ 'U', 'R', 'G' };
+   int strength = 100;
+   double smell = 1000.0;
+public:
+   static constexpr int NB_MAX = 1'000'000;
+#ifdef HOMEMADE_VERSION
+   void * operator new(std::size_t);
+   void * operator new[](std::size_t);
+   void operator delete(void *) noexcept;
+   void operator delete[](void *, std::size_t) noexcept;
+#endif
+};
+
+#endif
+
+//
+// Orc.cpp
+//
+// #include "Orc.h"
+
+#ifdef HOMEMADE_VERSION
+
+// #include "SizeBasedArena.h"
+
+using Tribe = SizeBasedArena<Orc, Orc::NB_MAX>;
+
+void * Orc::operator new(std::size_t) {
+   return Tribe::get().allocate_one();
+}
+// with a sized operator delete[], n includes the array cookie
+static constexpr std::size_t nb_orcs(std::size_t n) {
+   return (n + sizeof(Orc) - 1) / sizeof(Orc);
+}
+void * Orc::operator new[](std::size_t n) {
+   return Tribe::get().allocate_n(nb_orcs(n));
+}
+void Orc::operator delete(void *p) noexcept {
+   Tribe::get().deallocate_one(p);
+}
+void Orc::operator delete[](void *p, std::size_t n) noexcept {
+   Tribe::get().deallocate_n(p, nb_orcs(n));
+}
+
+#endif
+
+//
+// Test program
+//
+// #include "Orc.h"
+
+#include <chrono>
+#include <utility>
+
+template <class F, class ... Args>
+   auto test(F f, Args &&... args) {
+      using namespace std;
+      using namespace std::chrono;
+      auto pre = high_resolution_clock::now();
+      auto res = f(std::forward<Args>(args)...);
+      auto post = high_resolution_clock::now();
+      return pair{ res, post - pre };
+   }
+
+#include <algorithm>
+#include <print>
+#include <thread>
+#include <vector>
+int main() {
+   using namespace std;
+   using namespace std::chrono;
+#ifdef HOMEMADE_VERSION
+#ifdef USE_MAGAZINES
+   print("HOMEMADE VERSION (with magazines)\n");
+#else
+   print("HOMEMADE VERSION\n");
+#endif
+#else
+   print("STANDARD LIBRARY VERSION\n");
+#endif
+   //
+   // multi-threaded carnage: NB_ORCS orcs are created then killed,
+   // the work being split among 1, 2, 4... threads. Half the block
+   // is kept as headroom for the slots cached by the magazines
+   //
+   constexpr int NB_ORCS = Orc::NB_MAX / 2;
+   const int nb_cores = max(1u, thread::hardware_concurrency());
+   for(int nthreads = 1; nthreads <= nb_cores; nthreads *= 2) {
+      auto [r, dt] = test([nthreads] {
+         vector<jthread> th;
+         for(int t = 0; t != nthreads; ++t)
+            th.emplace_back([n = NB_ORCS / nthreads] {
+               vector<Orc*> orcs;
+               orcs.reserve(n);
+               for(int i = 0; i != n; ++i)
+                  orcs.push_back(new Orc);
+               // ...
+               // CARNAGE (CENSORED)
+               // ...
+               for(auto p : orcs)
+                  delete p;
+            });
+         return NB_ORCS / nthreads * nthreads;
+      });
+      print("{:>2} thread(s): {} orcs created and killed in {}\n",
+            nthreads, r, duration_cast<microseconds>(dt));
+   }
+}
@@ -0,0 +1,216 @@
+//
+// SizeBasedArena.h
+//
+
+#ifndef SIZE_BASED_ARENA_H
+#define SIZE_BASED_ARENA_H
+
+#include <atomic>
+#include <cassert>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <type_traits>
+
+//
+// bump policies: both hand out offsets of consecutive byte
+// ranges in a block of capacity bytes, and report exhaustion
+// by returning capacity
+//
+class locked_bump {
+   std::mutex m;
+   std::size_t cur = 0;
+public:
+   std::size_t advance(std::size_t n, std::size_t capacity) {
+      std::lock_guard _ { m };
+      if (capacity - cur < n) return capacity;
+      return std::exchange(cur, cur + n);
+   }
+};
+
+class atomic_bump {
+   // spawners contend on this cache line only
+   alignas(std::hardware_destructive_interference_size)
+      std::atomic<std::size_t> cur{ 0 };
+public:
+   std::size_t advance(std::size_t n, std::size_t capacity) {
+      // a failed attempt leaves cur past capacity, which
+      // makes every subsequent attempt fail too (no lock needed)
+      auto q = cur.fetch_add(n, std::memory_order_relaxed);
+      if (q > capacity || capacity - q < n) return capacity;
+      return q;
+   }
+};
+
+//
+// monotonic arena: memory is only released as a whole, at
+// destruction time, hence the no-op deallocation functions
+//
+template <class T, std::size_t N, class BumpPolicy = locked_bump>
+class SizeBasedArena {
+   static_assert(std::is_final_v<T>);
+   static constexpr std::size_t capacity = N * sizeof(T);
+   char *p;
+   BumpPolicy cur;
+   SizeBasedArena()
+      : p{ static_cast<char*>(std::malloc(capacity)) } {
+      assert(p);
+   }
+   SizeBasedArena(const SizeBasedArena&) = delete;
+   SizeBasedArena& operator=(const SizeBasedArena&) = delete;
+   void * bump(std::size_t n) {
+      auto q = cur.advance(n, capacity);
+      if (q == capacity) throw std::bad_alloc{};
+      return p + q;
+   }
+public:
+   ~SizeBasedArena() {
+      std::free(p);
+   }
+   static auto &get() {
+      static SizeBasedArena singleton;
+      return singleton;
+   }
+   void * allocate_one() {
+      return bump(sizeof(T));
+   }
+   void * allocate_n(std::size_t n) {
+      return bump(n * sizeof(T));
+   }
+   void deallocate_one(void *) noexcept {
+   }
+   void deallocate_n(void *) noexcept {
+   }
+};
+
+#endif
+
+
+//
+// Orc.h
+//
+
+#ifndef ORC_H
+#define ORC_H
+
+#define HOMEMADE_VERSION
+// comment out to protect the arena's cursor with a mutex
+#define LOCK_FREE_VERSION
+
+#include <cstddef>
+#include <new>
+
+class Orc final {
+   char name[4]{ 'U', 'R', 'G' };
+   int strength = 100;
+   double smell = 1000.0;
+public:
+   static constexpr int NB_MAX = 1'000'000;
+#ifdef HOMEMADE_VERSION
+   void * operator new(std::size_t);
+   void * operator new[](std::size_t);
+   void operator delete(void *) noexcept;
+   void operator delete[](void *) noexcept;
+#endif
+};
+
+#endif
+
+//
+// Orc.cpp
+//
+// #include "Orc.h"
+
+#ifdef HOMEMADE_VERSION
+
+// #include "SizeBasedArena.h"
+
+#ifdef LOCK_FREE_VERSION
+using Tribe = SizeBasedArena<Orc, Orc::NB_MAX, atomic_bump>;
+#else
+using Tribe = SizeBasedArena<Orc, Orc::NB_MAX, locked_bump>;
+#endif
+
+void * Orc::operator new(std::size_t) {
+   return Tribe::get().allocate_one();
+}
+void * Orc::operator new[](std::size_t n) {
+   return Tribe::get().allocate_n((n + sizeof(Orc) - 1) / sizeof(Orc));
+}
+void Orc::operator delete(void *p) noexcept {
+   Tribe::get().deallocate_one(p);
+}
+void Orc::operator delete[](void *p) noexcept {
+   Tribe::get().deallocate_n(p);
+}
+
+#endif
+
+//
+// Test program
+//
+// #include "Orc.h"
+
+#include <chrono>
+#include <utility>
+
+template <class F, class ... Args>
+   auto test(F f, Args &&... args) {
+      using namespace std;
+      using namespace std::chrono;
+      auto pre = high_resolution_clock::now();
+      auto res = f(std::forward<Args>(args)...);
+      auto post = high_resolution_clock::now();
+      return pair{ res, post - pre };
+   }
+
+#include <algorithm>
+#include <print>
+#include <thread>
+#include <vector>
+int main() {
+   using namespace std;
+   using namespace std::chrono;
+#ifdef HOMEMADE_VERSION
+#ifdef LOCK_FREE_VERSION
+   print("HOMEMADE VERSION (lock-free)\n");
+#else
+   print("HOMEMADE VERSION (locked)\n");
+#endif
+#else
+   print("STANDARD LIBRARY VERSION\n");
+#endif
+   //
+   // parallel spawners: Orc::NB_MAX orcs are created by 1 thread,
+   // then by 2, then by 4... Since the arena is monotonic, each round
+   // gets its share of the block, hence the division by the number of rounds
+   //
+   const int nb_cores = max(1u, thread::hardware_concurrency());
+   int nb_rounds = 0;
+   for(int nthreads = 1; nthreads <= nb_cores; nthreads *= 2)
+      ++nb_rounds;
+   const int nb_orcs = Orc::NB_MAX / nb_rounds;
+   for(int nthreads = 1; nthreads <= nb_cores; nthreads *= 2) {
+      vector<vector<Orc*>> orcs(nthreads);
+      for(auto &v : orcs)
+         v.reserve(nb_orcs / nthreads);
+      auto [r, dt] = test([&orcs, nthreads, n = nb_orcs / nthreads] {
+         vector<jthread> th;
+         for(int t = 0; t != nthreads; ++t)
+            th.emplace_back([&v = orcs[t], n] {
+               for(int i = 0; i != n; ++i)
+                  v.push_back(new Orc);
+            });
+         return n * nthreads;
+      });
+      // ...
+      // CARNAGE (CENSORED)
+      // ...
+      for(auto &v : orcs)
+         for(auto p : v)
+            delete p;
+      print("{:>2} thread(s): {} orcs created in {}\n",
+            nthreads, r, duration_cast<microseconds>(dt));
+   }
+}
@@ -7,16 +7,69 @@
 #ifndef SIZE_BASED_ARENA_H
 #define SIZE_BASED_ARENA_H
 
+#include <atomic>
 #include <cassert>
 #include <cstdlib>
 #include <mutex>
+#include <new>
+#include <utility>
 #include <type_traits>
 
+//
+// occupancy statistics; the counters are only written under the
+// arena's lock, but can be read at any time without it
+//
+struct arena_stats {
+   std::size_t bytes_reserved;
+   std::size_t bytes_in_use;
+   std::size_t high_water_mark;
+   std::size_t free_list_length;
+};
+
+class stat_counter {
+   std::atomic<std::size_t> n{ 0 };
+public:
+   // single writer (the lock holder): no need for a read-modify-write
+   void add(std::size_t k) noexcept {
+      n.store(n.load(std::memory_order_relaxed) + k, std::memory_order_relaxed);
+   }
+   void sub(std::size_t k) noexcept {
+      n.store(n.load(std::memory_order_relaxed) - k, std::memory_order_relaxed);
+   }
+   void raise_to(std::size_t k) noexcept {
+      if (k > n.load(std::memory_order_relaxed))
+         n.store(k, std::memory_order_relaxed);
+   }
+   std::size_t get() const noexcept {
+      return n.load(std::memory_order_relaxed);
+   }
+};
+
 template <class T, std::size_t N>
 class SizeBasedArena {
    static_assert(std::is_final_v<T>);
+   // released slots are reused through an intrusive free list
+   // threaded through the slots themselves, hence:
+   static_assert(sizeof(T) >= sizeof(void*) && alignof(T) >= alignof(void*));
+   struct free_slot {
+      free_slot *next;
+   };
+   // released spans of two slots or more (from allocate_n) are
+   // kept in their own list; single-slot spans join the slot list
+   struct free_span {
+      free_span *next;
+      std::size_t n;
+   };
+   // the nodes of both lists are placed in released slots, sizeof(T)
+   // bytes apart from the (max-aligned) start of the memory; a span
+   // covers two slots or more, hence:
+   static_assert(2 * sizeof(T) >= sizeof(free_span));
+   static_assert(alignof(T) >= alignof(free_span));
    std::mutex m;
    char *p, *cur;
+   free_slot *slots = nullptr;
+   free_span *spans = nullptr;
+   stat_counter in_use, high_water, free_entries;
    SizeBasedArena()
       : p{ static_cast<char*>(std::malloc(N * sizeof(T))) } {
       assert(p);
@@ -24,6 +77,25 @@ class SizeBasedArena {
    }
    SizeBasedArena(const SizeBasedArena&) = delete;
    SizeBasedArena& operator=(const SizeBasedArena&) = delete;
+   // precondition: m is locked
+   void * bump(std::size_t n) {
+      if (static_cast<std::size_t>(p + N * sizeof(T) - cur) < n * sizeof(T))
+         throw std::bad_alloc{};
+      auto q = cur;
+      cur += n * sizeof(T);
+      taken(n);
+      return q;
+   }
+   // precondition: m is locked
+   void taken(std::size_t n) noexcept {
+      in_use.add(n * sizeof(T));
+      high_water.raise_to(in_use.get());
+   }
+   // precondition: m is locked
+   void push_slot(void *q) noexcept {
+      slots = ::new (q) free_slot{ slots };
+      free_entries.add(1);
+   }
 public:
    ~SizeBasedArena() {
       std::free(p);
@@ -34,19 +106,51 @@ public:
    }
    void * allocate_one() {
       std::lock_guard _ { m };
-      auto q = cur;
-      cur += sizeof(T);
-      return q;
+      if (slots) {
+         free_entries.sub(1);
+         taken(1);
+         return std::exchange(slots, slots->next);
+      }
+      return bump(1);
    }
    void * allocate_n(std::size_t n) {
+      if (n == 1) return allocate_one();
       std::lock_guard _ { m };
-      auto q = cur;
-      cur += n * sizeof(T);
-      return q;
+      // first fit; what remains of the span stays available
+      for (auto pp = &spans; *pp; pp = &(*pp)->next) {
+         if (auto s = *pp; s->n >= n) {
+            auto q = reinterpret_cast<char*>(s);
+            auto rest = s->n - n;
+            *pp = s->next;
+            free_entries.sub(1);
+            if (rest == 1)
+               push_slot(q + n * sizeof(T));
+            else if (rest > 1) {
+               *pp = ::new (q + n * sizeof(T)) free_span{ *pp, rest };
+               free_entries.add(1);
+            }
+            taken(n);
+            return q;
+         }
+      }
+      return bump(n);
    }
-   void deallocate_one(void *) noexcept {
+   void deallocate_one(void *q) noexcept {
+      if (!q) return;
+      std::lock_guard _ { m };
+      push_slot(q);
+      in_use.sub(sizeof(T));
+   }
+   void deallocate_n(void *q, std::size_t n) noexcept {
+      if (!q) return;
+      if (n == 1) return deallocate_one(q);
+      std::lock_guard _ { m };
+      spans = ::new (q) free_span{ spans, n };
+      free_entries.add(1);
+      in_use.sub(n * sizeof(T));
    }
-   void deallocate_n(void *) noexcept {
+   arena_stats stats() const noexcept {
+      return { N * sizeof(T), in_use.get(), high_water.get(), free_entries.get() };
    }
 };
 
@@ -75,7 +179,7 @@ public:
    void * operator new(std::size_t);
    void * operator new[](std::size_t);
    void operator delete(void *) noexcept;
-   void operator delete[](void *) noexcept;
+   void operator delete[](void *, std::size_t) noexcept;
 #endif
 };
 
@@ -95,14 +199,18 @@ using Tribe = SizeBasedArena<Orc, Orc::NB_MAX>;
 void * Orc::operator new(std::size_t) {
    return Tribe::get().allocate_one();
 }
+// with a sized operator delete[], n includes the array cookie
+static constexpr std::size_t nb_orcs(std::size_t n) {
+   return (n + sizeof(Orc) - 1) / sizeof(Orc);
+}
 void * Orc::operator new[](std::size_t n) {
-   return Tribe::get().allocate_n(n / sizeof(Orc));
+   return Tribe::get().allocate_n(nb_orcs(n));
 }
 void Orc::operator delete(void *p) noexcept {
    Tribe::get().deallocate_one(p);
 }
-void Orc::operator delete[](void *p) noexcept {
-   Tribe::get().deallocate_n(p);
+void Orc::operator delete[](void *p, std::size_t n) noexcept {
+   Tribe::get().deallocate_n(p, nb_orcs(n));
 }
 
 #endif
@@ -152,4 +260,29 @@ int main() {
    });
    print("Construction: {} orcs in {}\n", size(orcs), duration_cast<microseconds>(dt0));
    print("Destruction:  {} orcs in {}\n", size(orcs), duration_cast<microseconds>(dt1));
+   //
+   // steady-state churn: a live population of NB_LIVE orcs where,
+   // at each step, one orc dies and another one takes its place
+   //
+   constexpr int NB_LIVE = Orc::NB_MAX / 10;
+   constexpr int NB_STEPS = Orc::NB_MAX * 10;
+   orcs.clear();
+   for(int i = 0; i != NB_LIVE; ++i)
+      orcs.push_back(new Orc);
+   auto [r2, dt2] = test([&orcs] {
+      for(int i = 0; i != NB_STEPS; ++i) {
+         auto &victim = orcs[(i * 7919ULL) % NB_LIVE];
+         delete victim;
+         victim = new Orc;
+      }
+      return NB_STEPS;
+   });
+   for(auto p : orcs)
+      delete p;
+   print("Churn:        {} orcs replaced in {}\n", r2, duration_cast<microseconds>(dt2));
+#ifdef HOMEMADE_VERSION
+   auto st = Tribe::get().stats();
+   print("Arena:        {} bytes reserved, {} in use, high-water mark {}, {} free list entries\n",
+         st.bytes_reserved, st.bytes_in_use, st.high_water_mark, st.free_list_length);
+#endif
 }
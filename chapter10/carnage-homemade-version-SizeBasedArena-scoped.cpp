@@ -0,0 +1,186 @@
+//
+// SizeBasedArena.h
+//
+
+#ifndef SIZE_BASED_ARENA_H
+#define SIZE_BASED_ARENA_H
+
+#include <cassert>
+#include <cstdlib>
+#include <new>
+#include <type_traits>
+
+//
+// non-singleton version, meant to be used by one thread (e.g. one
+// per request or per frame), hence no mutex. Memory is released in
+// bulk by moving the cursor back: to a mark, or to the beginning of
+// the block. No destructor runs when that happens, hence:
+//
+template <class T, std::size_t N>
+class SizeBasedArena {
+   static_assert(std::is_trivially_destructible_v<T>);
+   char *p, *cur;
+public:
+   using marker = char*;
+   SizeBasedArena()
+      : p{ static_cast<char*>(std::malloc(N * sizeof(T))) } {
+      if (!p) throw std::bad_alloc{};
+      cur = p;
+   }
+   SizeBasedArena(const SizeBasedArena&) = delete;
+   SizeBasedArena& operator=(const SizeBasedArena&) = delete;
+   ~SizeBasedArena() {
+      std::free(p);
+   }
+   void * allocate_one() {
+      return allocate_n(1);
+   }
+   void * allocate_n(std::size_t n) {
+      if (static_cast<std::size_t>(p + N * sizeof(T) - cur) < n * sizeof(T))
+         throw std::bad_alloc{};
+      auto q = cur;
+      cur += n * sizeof(T);
+      return q;
+   }
+   // individual objects are only released in bulk
+   void deallocate_one(void *) noexcept {
+   }
+   void deallocate_n(void *) noexcept {
+   }
+   // the current position; rewinding to it releases
+   // everything that was allocated since, in O(1)
+   marker mark() const noexcept {
+      return cur;
+   }
+   void rewind(marker m) noexcept {
+      assert(p <= m && m <= cur);
+      cur = m;
+   }
+   // releases everything, in O(1)
+   void reset() noexcept {
+      cur = p;
+   }
+   std::size_t size() const noexcept {
+      return (cur - p) / sizeof(T);
+   }
+   //
+   // releases, when it ends, everything allocated
+   // in the arena during its lifetime
+   //
+   class scope {
+      SizeBasedArena &arena;
+      marker m;
+   public:
+      explicit scope(SizeBasedArena &arena) noexcept
+         : arena{ arena }, m{ arena.mark() } {
+      }
+      scope(const scope&) = delete;
+      scope& operator=(const scope&) = delete;
+      ~scope() {
+         arena.rewind(m);
+      }
+   };
+};
+
+template <class T, std::size_t N>
+   void *operator new(std::size_t n, SizeBasedArena<T, N> &arena) {
+      return arena.allocate_n((n + sizeof(T) - 1) / sizeof(T));
+   }
+template <class T, std::size_t N>
+   void operator delete(void *p, SizeBasedArena<T, N> &arena) noexcept {
+      arena.deallocate_one(p);
+   }
+template <class T, std::size_t N>
+   void *operator new[](std::size_t n, SizeBasedArena<T, N> &arena) {
+      return arena.allocate_n((n + sizeof(T) - 1) / sizeof(T));
+   }
+template <class T, std::size_t N>
+   void operator delete[](void *p, SizeBasedArena<T, N> &arena) noexcept {
+      arena.deallocate_n(p);
+   }
+
+#endif
+
+
+//
+// Orc.h
+//
+
+#ifndef ORC_H
+#define ORC_H
+
+#include <cstddef>
+#include <new>
+
+class Orc final {
+   char name[4]{ 'U', 'R', 'G' };
+   int strength = 100;
+   double smell = 1000.0;
+public:
+   static constexpr int NB_MAX = 1'000'000;
+};
+
+#endif
+
+//
+// Test program
+//
+// #include "Orc.h"
+// #include "SizeBasedArena.h"
+
+#include <chrono>
+#include <utility>
+
+template <class F, class ... Args>
+   auto test(F f, Args &&... args) {
+      using namespace std;
+      using namespace std::chrono;
+      auto pre = high_resolution_clock::now();
+      auto res = f(std::forward<Args>(args)...);
+      auto post = high_resolution_clock::now();
+      return pair{ res, post - pre };
+   }
+
+#include <print>
+#include <vector>
+int main() {
+   using namespace std;
+   using namespace std::chrono;
+   //
+   // NB_REQUESTS requests, each of which needs NB_PER_REQUEST
+   // short-lived orcs, all dropped when the request ends
+   //
+   constexpr int NB_REQUESTS = 10'000;
+   constexpr int NB_PER_REQUEST = 1'000;
+   vector<Orc*> orcs;
+   orcs.reserve(NB_PER_REQUEST);
+   auto [r0, dt0] = test([&orcs] {
+      for(int r = 0; r != NB_REQUESTS; ++r) {
+         for(int i = 0; i != NB_PER_REQUEST; ++i)
+            orcs.push_back(new Orc);
+         // ...
+         // CARNAGE (CENSORED)
+         // ...
+         for(auto p : orcs)
+            delete p;
+         orcs.clear();
+      }
+      return NB_REQUESTS * NB_PER_REQUEST;
+   });
+   SizeBasedArena<Orc, Orc::NB_MAX> arena;
+   auto [r1, dt1] = test([&orcs, &arena] {
+      for(int r = 0; r != NB_REQUESTS; ++r) {
+         SizeBasedArena<Orc, Orc::NB_MAX>::scope _ { arena };
+         for(int i = 0; i != NB_PER_REQUEST; ++i)
+            orcs.push_back(new (arena) Orc);
+         // ...
+         // CARNAGE (CENSORED)
+         // ...
+         orcs.clear(); // the orcs themselves go away with the scope
+      }
+      return NB_REQUESTS * NB_PER_REQUEST;
+   });
+   print("Standard version: {} orcs in {}\n", r0, duration_cast<microseconds>(dt0));
+   print("Scoped arena:     {} orcs in {}\n", r1, duration_cast<microseconds>(dt1));
+   print("Orcs left in arena: {}\n", arena.size());
+}
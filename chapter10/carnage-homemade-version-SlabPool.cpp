@@ -0,0 +1,252 @@
+//
+// SlabPool.h
+//
+
+#ifndef SLAB_POOL_H
+#define SLAB_POOL_H
+
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+//
+// pool of Size-byte slots aligned on Align bytes, obtained from slabs
+// of (roughly) SLAB_BYTES bytes chained as needed. There is one pool
+// per (Size, Align) pair, shared by all types with that footprint,
+// rather than one SizeBasedArena per type: ten small types of the same
+// size share slabs instead of each having its own half-empty block
+//
+template <std::size_t Size, std::size_t Align>
+class SlabPool {
+   static_assert(Size % Align == 0);
+   // released slots are reused through an intrusive free list
+   // threaded through the slots themselves, hence slots are at
+   // least as big and as aligned as its nodes (a 12-byte object
+   // aligned on 4 bytes gets a 16-byte slot on most platforms)
+   struct free_slot {
+      free_slot *next;
+   };
+   static constexpr std::size_t slot_align =
+      Align > alignof(free_slot) ? Align : alignof(free_slot);
+   static constexpr std::size_t stride =
+      ((Size > sizeof(free_slot) ? Size : sizeof(free_slot)) + slot_align - 1)
+         / slot_align * slot_align;
+   static constexpr std::size_t SLAB_BYTES = 64 * 1024;
+   static constexpr std::size_t NB_PER_SLAB = stride < SLAB_BYTES ? SLAB_BYTES / stride : 1;
+   // each slab starts with this header, followed by its slots
+   struct slab {
+      slab *prev;
+   };
+   static constexpr std::size_t header_size =
+      (sizeof(slab) + slot_align - 1) / slot_align * slot_align;
+   static constexpr std::size_t slab_size = header_size + NB_PER_SLAB * stride;
+   static constexpr std::align_val_t slab_align {
+      slot_align > alignof(slab) ? slot_align : alignof(slab)
+   };
+   std::mutex m;
+   slab *last = nullptr;
+   char *cur = nullptr, *end = nullptr;
+   free_slot *slots = nullptr;
+   std::size_t nslabs = 0;
+   SlabPool() = default;
+   SlabPool(const SlabPool&) = delete;
+   SlabPool& operator=(const SlabPool&) = delete;
+   // precondition: m is locked
+   void add_slab() {
+      auto s = ::operator new(slab_size, slab_align);
+      last = ::new (s) slab{ last };
+      cur = static_cast<char*>(s) + header_size;
+      end = cur + NB_PER_SLAB * stride;
+      ++nslabs;
+   }
+public:
+   ~SlabPool() {
+      while (last)
+         ::operator delete(std::exchange(last, last->prev), slab_align);
+   }
+   static auto &get() {
+      static SlabPool singleton;
+      return singleton;
+   }
+   std::size_t nb_slabs() {
+      std::lock_guard _ { m };
+      return nslabs;
+   }
+   void * allocate_one() {
+      std::lock_guard _ { m };
+      if (slots)
+         return std::exchange(slots, slots->next);
+      if (cur == end)
+         add_slab();
+      return std::exchange(cur, cur + stride);
+   }
+   void deallocate_one(void *q) noexcept {
+      if (!q) return;
+      std::lock_guard _ { m };
+      slots = ::new (q) free_slot{ slots };
+   }
+};
+
+//
+// the pool objects of type T come from; the same for all types
+// of the same size and alignment. T has to be final, as a derived
+// class would inherit T's member operator new but not its size
+//
+template <class T>
+   auto &pool_for() {
+      static_assert(std::is_final_v<T>);
+      return SlabPool<sizeof(T), alignof(T)>::get();
+   }
+
+#endif
+
+
+//
+// Orc.h, Goblin.h, Troll.h
+//
+
+#ifndef MONSTERS_H
+#define MONSTERS_H
+
+#define HOMEMADE_VERSION
+
+#include <cstddef>
+#include <new>
+
+class Orc final {
+   char name[4]{ 'U', 'R', 'G' };
+   int strength = 100;
+   double smell = 1000.0;
+public:
+   static constexpr int NB_MAX = 1'000'000;
+#ifdef HOMEMADE_VERSION
+   void * operator new(std::size_t);
+   void operator delete(void *) noexcept;
+#endif
+};
+
+// not an Orc, but the same footprint
+class Goblin final {
+   int cunning = 10;
+   float speed = 3.5f;
+   double gold = 12.0;
+public:
+#ifdef HOMEMADE_VERSION
+   void * operator new(std::size_t);
+   void operator delete(void *) noexcept;
+#endif
+};
+
+// bigger, hence drawn from another pool
+class Troll final {
+   double weight = 900.0;
+   double height = 3.0;
+   int strength = 1'000;
+public:
+#ifdef HOMEMADE_VERSION
+   void * operator new(std::size_t);
+   void operator delete(void *) noexcept;
+#endif
+};
+
+#endif
+
+//
+// Orc.cpp, Goblin.cpp, Troll.cpp
+//
+
+#ifdef HOMEMADE_VERSION
+
+// #include "SlabPool.h"
+
+void * Orc::operator new(std::size_t) {
+   return pool_for<Orc>().allocate_one();
+}
+void Orc::operator delete(void *p) noexcept {
+   pool_for<Orc>().deallocate_one(p);
+}
+void * Goblin::operator new(std::size_t) {
+   return pool_for<Goblin>().allocate_one();
+}
+void Goblin::operator delete(void *p) noexcept {
+   pool_for<Goblin>().deallocate_one(p);
+}
+void * Troll::operator new(std::size_t) {
+   return pool_for<Troll>().allocate_one();
+}
+void Troll::operator delete(void *p) noexcept {
+   pool_for<Troll>().deallocate_one(p);
+}
+
+#endif
+
+//
+// Test program
+//
+
+#include <chrono>
+#include <utility>
+
+template <class F, class ... Args>
+   auto test(F f, Args &&... args) {
+      using namespace std;
+      using namespace std::chrono;
+      auto pre = high_resolution_clock::now();
+      auto res = f(std::forward<Args>(args)...);
+      auto post = high_resolution_clock::now();
+      return pair{ res, post - pre };
+   }
+
+#include <print>
+#include <vector>
+int main() {
+   using namespace std;
+   using namespace std::chrono;
+#ifdef HOMEMADE_VERSION
+   print("HOMEMADE VERSION\n");
+#else
+   print("STANDARD LIBRARY VERSION\n");
+#endif
+   //
+   // an army of orcs is replaced by an army of goblins, with
+   // a few trolls along; the goblins reuse the orcs' slots
+   //
+   vector<Orc*> orcs;
+   vector<Goblin*> goblins;
+   vector<Troll*> trolls;
+   orcs.reserve(Orc::NB_MAX);
+   goblins.reserve(Orc::NB_MAX);
+   auto [r0, dt0] = test([&] {
+      for(int i = 0; i != Orc::NB_MAX; ++i) {
+         orcs.push_back(new Orc);
+         if(i % 100 == 0)
+            trolls.push_back(new Troll);
+      }
+      return size(orcs) + size(trolls);
+   });
+   auto [r1, dt1] = test([&] {
+      for(auto &p : orcs) {
+         delete p;
+         goblins.push_back(new Goblin);
+      }
+      return size(orcs) + size(goblins);
+   });
+   auto [r2, dt2] = test([&] {
+      for(auto p : goblins)
+         delete p;
+      for(auto p : trolls)
+         delete p;
+      return size(goblins) + size(trolls);
+   });
+   print("Orcs and trolls:      {} monsters in {}\n", r0, duration_cast<microseconds>(dt0));
+   print("Orcs become goblins:  {} monsters in {}\n", r1, duration_cast<microseconds>(dt1));
+   print("Goblins and trolls:   {} monsters in {}\n", r2, duration_cast<microseconds>(dt2));
+#ifdef HOMEMADE_VERSION
+   print("Orcs and goblins share a pool: {}, of {} slabs\n",
+         static_cast<void*>(&pool_for<Orc>()) == static_cast<void*>(&pool_for<Goblin>()),
+         pool_for<Orc>().nb_slabs());
+   print("Trolls have their own pool of {} slabs\n", pool_for<Troll>().nb_slabs());
+#endif
+}
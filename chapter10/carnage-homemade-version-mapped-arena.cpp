@@ -0,0 +1,336 @@
+//
+// MappedRegion.h
+//
+
+#ifndef MAPPED_REGION_H
+#define MAPPED_REGION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <string_view>
+#include <utility>
+#include <sys/mman.h>
+
+//
+// how the memory under an arena is obtained:
+// - Heap:       std::malloc, as in the other versions
+// - Mapped:     anonymous mmap, pages faulted in on first touch
+// - Prefaulted: anonymous mmap with MAP_POPULATE, pages faulted in up front
+// - HugePages:  anonymous mmap aligned on 2 MiB with madvise(MADV_HUGEPAGE),
+//               hoping for transparent huge pages (fewer faults, fewer TLB misses)
+//
+enum class Backing { Heap, Mapped, Prefaulted, HugePages };
+
+constexpr std::string_view to_string(Backing b) {
+   using enum Backing;
+   switch(b) {
+   case Heap: return "heap";
+   case Mapped: return "mapped";
+   case Prefaulted: return "prefaulted";
+   case HugePages: return "huge pages";
+   }
+   return "?";
+}
+
+//
+// owns a region of (at least) n bytes obtained as requested; if
+// the request cannot be honored (e.g. madvise() fails because THP
+// are disabled), a weaker mode is used and reported by backing()
+//
+class MappedRegion {
+   static constexpr std::size_t huge_page_size = 2 * 1024 * 1024;
+   void *base = nullptr; // what to give back to the system
+   std::size_t len = 0;  // idem
+   void *p = nullptr;
+   Backing mode;
+   static void *map(std::size_t n, int flags) {
+      void *q = mmap(nullptr, n, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | flags, -1, 0);
+      if (q == MAP_FAILED) throw std::bad_alloc{};
+      return q;
+   }
+public:
+   MappedRegion(std::size_t n, Backing requested) : mode{ requested } {
+      using enum Backing;
+      switch(mode) {
+      case Heap:
+         p = base = std::malloc(n);
+         if (!p) throw std::bad_alloc{};
+         break;
+      case Mapped:
+         p = base = map(len = n, 0);
+         break;
+      case Prefaulted:
+         p = base = map(len = n, MAP_POPULATE);
+         break;
+      case HugePages: {
+         // over-allocate, then trim so that p is 2 MiB-aligned
+         n = (n + huge_page_size - 1) / huge_page_size * huge_page_size;
+         auto raw = static_cast<char*>(map(n + huge_page_size, 0));
+         auto addr = reinterpret_cast<std::uintptr_t>(raw);
+         auto head = (huge_page_size - addr % huge_page_size) % huge_page_size;
+         if (head) munmap(raw, head);
+         munmap(raw + head + n, huge_page_size - head);
+         p = base = raw + head;
+         len = n;
+         if (madvise(p, len, MADV_HUGEPAGE) != 0)
+            mode = Mapped;
+         break;
+      }
+      }
+   }
+   MappedRegion(const MappedRegion&) = delete;
+   MappedRegion& operator=(const MappedRegion&) = delete;
+   ~MappedRegion() {
+      if (mode == Backing::Heap)
+         std::free(base);
+      else
+         munmap(base, len);
+   }
+   void *get() const noexcept { return p; }
+   Backing backing() const noexcept { return mode; }
+};
+
+// used by the arenas below when first constructed; set it before that
+inline Backing requested_backing = Backing::Heap;
+
+#endif
+
+//
+// SizeBasedArena.h
+//
+
+#ifndef SIZE_BASED_ARENA_H
+#define SIZE_BASED_ARENA_H
+
+#include <mutex>
+#include <type_traits>
+// #include "MappedRegion.h"
+
+template <class T, std::size_t N>
+class SizeBasedArena {
+   static_assert(std::is_final_v<T>);
+   // released slots are reused through an intrusive free list
+   // threaded through the slots themselves, hence:
+   static_assert(sizeof(T) >= sizeof(void*) && alignof(T) >= alignof(void*));
+   struct free_slot {
+      free_slot *next;
+   };
+   std::mutex m;
+   MappedRegion region;
+   char *p, *cur;
+   free_slot *slots = nullptr;
+   SizeBasedArena()
+      : region{ N * sizeof(T), requested_backing },
+        p{ static_cast<char*>(region.get()) } {
+      cur = p;
+   }
+   SizeBasedArena(const SizeBasedArena&) = delete;
+   SizeBasedArena& operator=(const SizeBasedArena&) = delete;
+public:
+   static auto &get() {
+      static SizeBasedArena singleton;
+      return singleton;
+   }
+   Backing backing() const noexcept {
+      return region.backing();
+   }
+   void * allocate_one() {
+      std::lock_guard _ { m };
+      if (slots)
+         return std::exchange(slots, slots->next);
+      if (cur == p + N * sizeof(T)) throw std::bad_alloc{};
+      return std::exchange(cur, cur + sizeof(T));
+   }
+   void deallocate_one(void *q) noexcept {
+      if (!q) return;
+      std::lock_guard _ { m };
+      slots = ::new (q) free_slot{ slots };
+   }
+};
+
+#endif
+
+
+//
+// Orc.h
+//
+
+#ifndef ORC_H
+#define ORC_H
+
+#define HOMEMADE_VERSION
+// comment out to use SizeBasedArena<Orc, Orc::NB_MAX> instead of Tribe
+#define TRIBE_VERSION
+
+#include <cstddef>
+#include <new>
+
+class Orc final {
+   char name[4]{ 'U', 'R', 'G' };
+   int strength = 100;
+   double smell = 1000.0;
+public:
+   static constexpr int NB_MAX = 1'000'000;
+#ifdef HOMEMADE_VERSION
+   void * operator new(std::size_t);
+   void operator delete(void *) noexcept;
+#endif
+};
+
+#endif
+
+//
+// Orc.cpp
+//
+// #include "Orc.h"
+
+#ifdef HOMEMADE_VERSION
+
+#ifdef TRIBE_VERSION
+
+#include <mutex>
+// #include "MappedRegion.h"
+
+class Tribe {
+   std::mutex m;
+   MappedRegion region;
+   char *p, *cur;
+   Tribe()
+      : region{ Orc::NB_MAX * sizeof(Orc), requested_backing },
+        p{ static_cast<char*>(region.get()) } {
+      cur = p;
+   }
+   Tribe(const Tribe&) = delete;
+   Tribe& operator=(const Tribe&) = delete;
+public:
+   static auto &get() {
+      static Tribe singleton;
+      return singleton;
+   }
+   Backing backing() const noexcept {
+      return region.backing();
+   }
+   void * allocate() {
+      std::lock_guard _ { m };
+      auto q = cur;
+      cur += sizeof(Orc);
+      return q;
+   }
+   void deallocate(void *) noexcept {
+   }
+};
+
+void * Orc::operator new(std::size_t) {
+   return Tribe::get().allocate();
+}
+void Orc::operator delete(void *p) noexcept {
+   Tribe::get().deallocate(p);
+}
+
+#else
+
+// #include "SizeBasedArena.h"
+
+using Tribe = SizeBasedArena<Orc, Orc::NB_MAX>;
+
+void * Orc::operator new(std::size_t) {
+   return Tribe::get().allocate_one();
+}
+void Orc::operator delete(void *p) noexcept {
+   Tribe::get().deallocate_one(p);
+}
+
+#endif
+
+#endif
+
+//
+// Test program
+//
+// #include "Orc.h"
+
+#include <chrono>
+#include <utility>
+
+template <class F, class ... Args>
+   auto test(F f, Args &&... args) {
+      using namespace std;
+      using namespace std::chrono;
+      auto pre = high_resolution_clock::now();
+      auto res = f(std::forward<Args>(args)...);
+      auto post = high_resolution_clock::now();
+      return pair{ res, post - pre };
+   }
+
+#include <sys/resource.h>
+
+// minor page faults so far for this process
+long nb_page_faults() {
+   rusage usage{};
+   getrusage(RUSAGE_SELF, &usage);
+   return usage.ru_minflt;
+}
+
+//
+// usage: program [heap|mapped|prefaulted|huge]
+// (TLB misses can be observed by running this under
+// perf stat -e dTLB-load-misses,dTLB-store-misses)
+//
+#include <print>
+#include <string_view>
+#include <vector>
+int main(int argc, char *argv[]) {
+   using namespace std;
+   using namespace std::chrono;
+   if (argc > 1) {
+      using enum Backing;
+      string_view arg = argv[1];
+      bool found = false;
+      for (auto b : { Heap, Mapped, Prefaulted, HugePages })
+         if (!arg.empty() && arg == to_string(b).substr(0, arg.size())) {
+            requested_backing = b;
+            found = true;
+         }
+      if (!found) {
+         print(stderr, "usage: {} [heap|mapped|prefaulted|huge]\n", argv[0]);
+         return 1;
+      }
+   }
+   vector<Orc*> orcs;
+   orcs.reserve(Orc::NB_MAX);
+#ifdef HOMEMADE_VERSION
+   // setup (mapping, prefaulting if requested) is measured apart
+   auto f0 = nb_page_faults();
+   auto [setup, dts] = test([] { return Tribe::get().backing(); });
+   auto f1 = nb_page_faults();
+#ifdef TRIBE_VERSION
+   print("HOMEMADE VERSION (Tribe)\n");
+#else
+   print("HOMEMADE VERSION (SizeBasedArena)\n");
+#endif
+   print("Backing:      {} (requested: {})\n", to_string(setup), to_string(requested_backing));
+   print("Setup:        {} page faults in {}\n", f1 - f0, duration_cast<microseconds>(dts));
+#else
+   print("STANDARD LIBRARY VERSION\n");
+#endif
+   auto f2 = nb_page_faults();
+   auto [r0, dt0] = test([&orcs] {
+      for(int i = 0; i != Orc::NB_MAX; ++i)
+         orcs.push_back(new Orc);
+      return size(orcs);
+   });
+   auto f3 = nb_page_faults();
+   // ...
+   // CARNAGE (CENSORED)
+   // ...
+   auto [r1, dt1] = test([&orcs] {
+      for(auto p : orcs)
+         delete p;
+      return size(orcs);
+   });
+   print("Construction: {} orcs in {}, {} page faults\n", size(orcs), duration_cast<microseconds>(dt0), f3 - f2);
+   print("Destruction:  {} orcs in {}\n", size(orcs), duration_cast<microseconds>(dt1));
+}
@@ -8,6 +8,8 @@
 //
 
 #define HOMEMADE_VERSION
+// uncomment to advance the Tribe's cursor atomically instead of under a mutex
+// #define LOCK_FREE_TRIBE
 
 #include <cstddef>
 #include <new>
@@ -35,17 +37,56 @@ public:
 
 #ifdef HOMEMADE_VERSION
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cstdlib>
+#ifndef LOCK_FREE_TRIBE
 #include <mutex>
+#endif
+
+//
+// occupancy statistics; the counters are only written under the
+// Tribe's lock, but can be read at any time without it
+//
+struct arena_stats {
+   std::size_t bytes_reserved;
+   std::size_t bytes_in_use;
+   std::size_t high_water_mark;
+   std::size_t free_list_length;
+};
+
+class stat_counter {
+   std::atomic<std::size_t> n{ 0 };
+public:
+   // single writer (the lock holder): no need for a read-modify-write
+   void add(std::size_t k) noexcept {
+      n.store(n.load(std::memory_order_relaxed) + k, std::memory_order_relaxed);
+   }
+   std::size_t get() const noexcept {
+      return n.load(std::memory_order_relaxed);
+   }
+};
+
 
 class Tribe {
+#ifdef LOCK_FREE_TRIBE
+   char *p;
+   // offset from p; exhaustion is detected without a lock
+   alignas(std::hardware_destructive_interference_size)
+      std::atomic<std::size_t> cur{ 0 };
+   Tribe() : p{ static_cast<char*>(std::malloc(Orc::NB_MAX * sizeof(Orc))) } {
+      assert(p);
+   }
+#else
    std::mutex m;
    char *p, *cur;
+   stat_counter in_use;
    Tribe() : p{ static_cast<char*>(std::malloc(Orc::NB_MAX * sizeof(Orc))) } {
       assert(p);
       cur = p;
    }
+#endif
    Tribe(const Tribe&) = delete;
    Tribe& operator=(const Tribe&) = delete;
 public:
@@ -57,13 +98,30 @@ public:
       return singleton;
    }
    void * allocate() {
+#ifdef LOCK_FREE_TRIBE
+      auto q = cur.fetch_add(sizeof(Orc), std::memory_order_relaxed);
+      if (q >= Orc::NB_MAX * sizeof(Orc)) throw std::bad_alloc{};
+      return p + q;
+#else
       std::lock_guard _ { m };
       auto q = cur;
       cur += sizeof(Orc);
+      in_use.add(sizeof(Orc));
       return q;
+#endif
    }
    void deallocate(void *) noexcept {
    }
+   arena_stats stats() const noexcept {
+      constexpr std::size_t capacity = Orc::NB_MAX * sizeof(Orc);
+#ifdef LOCK_FREE_TRIBE
+      auto used = std::min(cur.load(std::memory_order_relaxed), capacity);
+#else
+      auto used = in_use.get();
+#endif
+      // memory is never given back, so what is in use is also the high-water mark
+      return { capacity, used, used, 0 };
+   }
 };
        
 void * Orc::operator new(std::size_t) {
@@ -126,4 +184,9 @@ int main() {
    });
    print("Construction: {} orcs in {}\n", size(orcs), duration_cast<microseconds>(dt0));
    print("Destruction:  {} orcs in {}\n", size(orcs), duration_cast<microseconds>(dt1));
+#ifdef HOMEMADE_VERSION
+   auto st = Tribe::get().stats();
+   print("Tribe:        {} bytes reserved, {} in use, high-water mark {}\n",
+         st.bytes_reserved, st.bytes_in_use, st.high_water_mark);
+#endif
 }
@@ -0,0 +1,242 @@
+//
+// Tribe.h
+//
+
+#ifndef TRIBE_H
+#define TRIBE_H
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+//
+// columnar (struct-of-arrays) storage for orcs: each attribute
+// lives in its own contiguous array, aligned on ALIGN bytes, so
+// that a pass over one attribute only brings that attribute in
+// cache, and so that the bulk operations below can be vectorized
+// by the compiler (build with e.g. -O3 -march=native to see it)
+//
+class Tribe {
+public:
+   static constexpr std::size_t ALIGN = 64;
+   using name_type = std::array<char, 4>;
+private:
+   template <class T>
+      struct aligned_delete {
+         void operator()(T *p) const noexcept {
+            ::operator delete(p, std::align_val_t{ ALIGN });
+         }
+      };
+   template <class T>
+      using aligned_array = std::unique_ptr<T[], aligned_delete<T>>;
+   template <class T>
+      static aligned_array<T> make_aligned_array(std::size_t n) {
+         static_assert(std::is_trivially_destructible_v<T>);
+         auto p = static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t{ ALIGN }));
+         std::uninitialized_value_construct_n(p, n);
+         return aligned_array<T>{ p };
+      }
+   std::size_t n = 0;
+   std::size_t cap;
+   aligned_array<name_type> names;
+   aligned_array<int> strengths;
+   aligned_array<double> smells;
+   // the compiler cannot know that our arrays are aligned
+   template <class T>
+      static T *aligned(const aligned_array<T> &p) noexcept {
+         return std::assume_aligned<ALIGN>(p.get());
+      }
+public:
+   //
+   // lightweight handle: a tribe and an index, giving access
+   // to the attributes of one orc
+   //
+   class orc_handle {
+      Tribe *tribe;
+      std::size_t i;
+   public:
+      orc_handle(Tribe &tribe, std::size_t i) noexcept : tribe{ &tribe }, i{ i } {
+      }
+      name_type &name() const noexcept { return tribe->names[i]; }
+      int &strength() const noexcept { return tribe->strengths[i]; }
+      double &smell() const noexcept { return tribe->smells[i]; }
+   };
+   explicit Tribe(std::size_t capacity)
+      : cap{ capacity },
+        names{ make_aligned_array<name_type>(capacity) },
+        strengths{ make_aligned_array<int>(capacity) },
+        smells{ make_aligned_array<double>(capacity) } {
+   }
+   std::size_t size() const noexcept { return n; }
+   std::size_t capacity() const noexcept { return cap; }
+   orc_handle operator[](std::size_t i) noexcept {
+      assert(i < n);
+      return { *this, i };
+   }
+   orc_handle spawn(name_type name = { 'U', 'R', 'G' }, int strength = 100, double smell = 1000.0) {
+      if (n == cap) throw std::bad_alloc{};
+      names[n] = name;
+      strengths[n] = strength;
+      smells[n] = smell;
+      return { *this, n++ };
+   }
+   // every orc dies at once
+   void clear() noexcept {
+      n = 0;
+   }
+   //
+   // bulk operations
+   //
+   std::size_t count_stronger_than(int threshold) const noexcept {
+      auto s = aligned(strengths);
+      std::size_t count = 0;
+      for (std::size_t i = 0; i != n; ++i)
+         count += s[i] > threshold;
+      return count;
+   }
+   // appends to out the indices of the orcs stronger than threshold
+   void select_stronger_than(int threshold, std::vector<std::size_t> &out) const {
+      auto s = aligned(strengths);
+      auto k = std::size(out);
+      out.resize(k + n);
+      auto dest = out.data() + k;
+      std::size_t m = 0;
+      for (std::size_t i = 0; i != n; ++i) {
+         dest[m] = i; // branchless: kept only if m advances
+         m += s[i] > threshold;
+      }
+      out.resize(k + m);
+   }
+   double total_smell() const noexcept {
+      // independent partial sums, as floating point addition
+      // is not associative and would otherwise stay sequential
+      constexpr std::size_t LANES = 8;
+      auto s = aligned(smells);
+      double partial[LANES] {};
+      std::size_t i = 0;
+      for (; i + LANES <= n; i += LANES)
+         for (std::size_t j = 0; j != LANES; ++j)
+            partial[j] += s[i + j];
+      double total = 0.0;
+      for (; i != n; ++i)
+         total += s[i];
+      for (auto x : partial)
+         total += x;
+      return total;
+   }
+   void strengthen(int delta) noexcept {
+      auto s = aligned(strengths);
+      for (std::size_t i = 0; i != n; ++i)
+         s[i] += delta;
+   }
+   void scale_smell(double factor) noexcept {
+      auto s = aligned(smells);
+      for (std::size_t i = 0; i != n; ++i)
+         s[i] *= factor;
+   }
+};
+
+#endif
+
+//
+// Orc.h (the usual array-of-structs layout, for comparison)
+//
+
+#ifndef ORC_H
+#define ORC_H
+
+class Orc final {
+   char name[4]{ 'U', 'R', 'G' };
+   int strength_ = 100;
+   double smell_ = 1000.0;
+public:
+   static constexpr int NB_MAX = 1'000'000;
+   Orc() = default;
+   Orc(int strength, double smell) : strength_{ strength }, smell_{ smell } {
+   }
+   int &strength() noexcept { return strength_; }
+   int strength() const noexcept { return strength_; }
+   double &smell() noexcept { return smell_; }
+   double smell() const noexcept { return smell_; }
+};
+
+#endif
+
+//
+// Test program
+//
+
+#include <chrono>
+#include <utility>
+
+template <class F, class ... Args>
+   auto test(F f, Args &&... args) {
+      using namespace std;
+      using namespace std::chrono;
+      auto pre = high_resolution_clock::now();
+      auto res = f(std::forward<Args>(args)...);
+      auto post = high_resolution_clock::now();
+      return pair{ res, post - pre };
+   }
+
+#include <print>
+#include <vector>
+int main() {
+   using namespace std;
+   using namespace std::chrono;
+   constexpr int THRESHOLD = 125;
+   //
+   // AoS: orcs side by side, as in the arenas
+   //
+   vector<Orc> aos;
+   aos.reserve(Orc::NB_MAX);
+   for(int i = 0; i != Orc::NB_MAX; ++i)
+      aos.emplace_back(100 + i % 50, 1000.0 + i % 7);
+   vector<size_t> selected;
+   selected.reserve(Orc::NB_MAX);
+   auto [a0, dta0] = test([&aos, &selected] {
+      for(size_t i = 0; i != size(aos); ++i)
+         if(aos[i].strength() > THRESHOLD)
+            selected.push_back(i);
+      return size(selected);
+   });
+   auto [a1, dta1] = test([&aos] {
+      double total = 0.0;
+      for(auto &orc : aos)
+         total += orc.smell();
+      return total;
+   });
+   auto [a2, dta2] = test([&aos] {
+      for(auto &orc : aos)
+         orc.strength() += 1;
+      return size(aos);
+   });
+   //
+   // SoA: one array per attribute
+   //
+   Tribe soa{ Orc::NB_MAX };
+   for(int i = 0; i != Orc::NB_MAX; ++i)
+      soa.spawn({ 'U', 'R', 'G' }, 100 + i % 50, 1000.0 + i % 7);
+   selected.clear();
+   auto [s0, dts0] = test([&soa, &selected] {
+      soa.select_stronger_than(THRESHOLD, selected);
+      return size(selected);
+   });
+   auto [s1, dts1] = test([&soa] {
+      return soa.total_smell();
+   });
+   auto [s2, dts2] = test([&soa] {
+      soa.strengthen(1);
+      return soa.size();
+   });
+   print("AoS, filter by strength: {} orcs in {}\n", a0, duration_cast<microseconds>(dta0));
+   print("SoA, filter by strength: {} orcs in {}\n", s0, duration_cast<microseconds>(dts0));
+   print("AoS, total smell:        {} in {}\n", a1, duration_cast<microseconds>(dta1));
+   print("SoA, total smell:        {} in {}\n", s1, duration_cast<microseconds>(dts1));
+   print("AoS, strengthen:         {} orcs in {}\n", a2, duration_cast<microseconds>(dta2));
+   print("SoA, strengthen:         {} orcs in {}\n", s2, duration_cast<microseconds>(dts2));
+}
@@ -0,0 +1,315 @@
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdlib>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+//
+// request-size distribution, recorded with relaxed atomics
+// so that it can be fed from any thread while in use
+//
+class SizeHistogram {
+public:
+   static constexpr std::size_t max_size = 4096;
+private:
+   std::atomic<std::size_t> counts[max_size + 1] {};
+   std::atomic<std::size_t> oversized{ 0 };
+public:
+   void record(std::size_t n) noexcept {
+      if(n > max_size)
+         oversized.fetch_add(1, std::memory_order_relaxed);
+      else
+         counts[n].fetch_add(1, std::memory_order_relaxed);
+   }
+   std::size_t count(std::size_t n) const noexcept {
+      return counts[n].load(std::memory_order_relaxed);
+   }
+   std::size_t nb_oversized() const noexcept {
+      return oversized.load(std::memory_order_relaxed);
+   }
+};
+
+//
+// profiling mode: allocates as ::operator new does, recording
+// the size of every request
+//
+class SizeProfiler {
+   SizeHistogram hist;
+public:
+   void *allocate(std::size_t n) {
+      hist.record(n);
+      return ::operator new(n);
+   }
+   void deallocate(void *p, std::size_t n) {
+      ::operator delete(p, n);
+   }
+   const SizeHistogram &histogram() const noexcept {
+      return hist;
+   }
+};
+
+// chunk sizes are multiples of this, to keep chunks suitably aligned
+constexpr std::size_t granularity = alignof(std::max_align_t);
+
+constexpr std::size_t round_up(std::size_t n) {
+   return (n + granularity - 1) / granularity * granularity;
+}
+
+//
+// chooses at most max_classes chunk sizes (multiples of granularity)
+// minimizing the internal fragmentation of the recorded traffic, i.e.
+// the sum of (chunk size - request size) over all requests. Requests
+// are grouped by rounded size; candidate chunk sizes are these rounded
+// sizes, a group going to the smallest chosen size that fits. This
+// is solved exactly by dynamic programming
+//
+std::vector<std::size_t> learn_size_classes(const SizeHistogram &hist, std::size_t max_classes) {
+   assert(max_classes > 0);
+   // groups: rounded size, number of requests, sum of request sizes
+   std::vector<std::size_t> sz, cnt { 0 }, sum { 0 }; // cnt, sum: prefix sums
+   for(std::size_t n = 1; n <= SizeHistogram::max_size; ++n) {
+      auto c = hist.count(n);
+      if(!c) continue;
+      if(sz.empty() || sz.back() != round_up(n)) {
+         sz.push_back(round_up(n));
+         cnt.push_back(cnt.back());
+         sum.push_back(sum.back());
+      }
+      cnt.back() += c;
+      sum.back() += c * n;
+   }
+   const auto m = std::size(sz);
+   if(m == 0) return {};
+   // waste if groups a..b (inclusive) go to chunks of size sz[b]
+   auto waste = [&](std::size_t a, std::size_t b) {
+      return sz[b] * (cnt[b + 1] - cnt[a]) - (sum[b + 1] - sum[a]);
+   };
+   constexpr auto inf = std::numeric_limits<std::size_t>::max();
+   const auto k_max = std::min(max_classes, m);
+   // best[k][b]: least waste for groups 0..b with k + 1 classes, the largest being sz[b]
+   // from[k][b]: first group going to sz[b] in that case
+   std::vector best(k_max, std::vector<std::size_t>(m, inf));
+   std::vector from(k_max, std::vector<std::size_t>(m, 0));
+   for(std::size_t b = 0; b != m; ++b)
+      best[0][b] = waste(0, b);
+   for(std::size_t k = 1; k != k_max; ++k)
+      for(std::size_t b = k; b != m; ++b)
+         for(std::size_t a = k; a <= b; ++a)
+            if(auto w = best[k - 1][a - 1]; w != inf && w + waste(a, b) < best[k][b]) {
+               best[k][b] = w + waste(a, b);
+               from[k][b] = a;
+            }
+   // the largest group has to fit
+   auto k = static_cast<std::size_t>(std::min_element(
+      std::begin(best), std::end(best), [m](auto &x, auto &y) { return x[m - 1] < y[m - 1]; }
+   ) - std::begin(best));
+   std::vector<std::size_t> classes;
+   for(auto b = m - 1; ; --k) {
+      classes.push_back(sz[b]);
+      if(k == 0) break;
+      b = from[k][b] - 1;
+   }
+   std::reverse(std::begin(classes), std::end(classes));
+   return classes;
+}
+
+// internal fragmentation of the recorded traffic for a given set of
+// (sorted) chunk sizes; requests that fit in none are not counted
+std::size_t internal_fragmentation(const SizeHistogram &hist, const std::vector<std::size_t> &classes) {
+   std::size_t total = 0;
+   for(std::size_t n = 1; n <= SizeHistogram::max_size; ++n)
+      if(auto p = std::lower_bound(std::begin(classes), std::end(classes), n); p != std::end(classes))
+         total += hist.count(n) * (*p - n);
+   return total;
+}
+
+//
+// a ChunkSizedAllocator whose size classes are chosen at runtime,
+// typically through learn_size_classes(); they need not be powers
+// of two, so the class lookup table is built at construction time
+//
+class AdaptiveChunkAllocator {
+   std::vector<std::size_t> sizes;
+   // size_class[(n + granularity - 1) / granularity]: smallest class that fits n bytes
+   std::vector<std::size_t> size_class;
+   std::size_t n_per_class;
+   std::size_t stride;
+   char *base;
+   // released chunks, threaded through the chunks themselves
+   struct free_chunk {
+      free_chunk *next;
+   };
+   // each size class has its own lock, on its own cache line
+   struct alignas(std::hardware_destructive_interference_size) chunk_class {
+      std::mutex m;
+      std::size_t cur = 0;
+      free_chunk *free = nullptr;
+   };
+   std::unique_ptr<chunk_class[]> classes;
+   bool within_blocks(void *p) const {
+      return !std::less{}(p, base) &&
+             std::less{}(p, base + std::size(sizes) * stride);
+   }
+   // precondition: within_blocks(p)
+   void recycle(void *p) {
+      auto &c = classes[(static_cast<char*>(p) - base) / stride];
+      std::lock_guard _ { c.m };
+      c.free = ::new (p) free_chunk{ c.free };
+   }
+public:
+   AdaptiveChunkAllocator(const AdaptiveChunkAllocator&) = delete;
+   AdaptiveChunkAllocator& operator=(const AdaptiveChunkAllocator&) = delete;
+   // N chunks for each of the (sorted, nonempty) sizes
+   AdaptiveChunkAllocator(std::size_t N, std::vector<std::size_t> chunk_sizes)
+      : sizes(std::move(chunk_sizes)), n_per_class{ N } {
+      assert(N > 0 && !sizes.empty() && std::is_sorted(std::begin(sizes), std::end(sizes)));
+      for(auto &sz : sizes)
+         sz = std::max(round_up(sz), round_up(sizeof(free_chunk)));
+      size_class.resize(sizes.back() / granularity + 1);
+      for(std::size_t j = 0, i = 0; j != std::size(size_class); ++j) {
+         while(j * granularity > sizes[i]) ++i;
+         size_class[j] = i;
+      }
+      stride = N * sizes.back();
+      base = static_cast<char*>(std::malloc(std::size(sizes) * stride));
+      assert(base);
+      classes = std::make_unique<chunk_class[]>(std::size(sizes));
+   }
+   ~AdaptiveChunkAllocator() {
+      std::free(base);
+   }
+   const std::vector<std::size_t>& chunk_sizes() const noexcept {
+      return sizes;
+   }
+   void *allocate(std::size_t n) {
+      if(n <= sizes.back()) {
+         // use smallest block available
+         for(auto i = size_class[(n + granularity - 1) / granularity]; i != std::size(sizes); ++i) {
+            auto &c = classes[i];
+            std::lock_guard _ { c.m };
+            if(c.free)
+               return std::exchange(c.free, c.free->next);
+            if(c.cur < n_per_class)
+               return base + i * stride + c.cur++ * sizes[i];
+         }
+      }
+      // either no block fits or no block left
+      return ::operator new(n);
+   }
+   void deallocate(void *p) {
+      if(within_blocks(p)) {
+         recycle(p);
+         return;
+      }
+      // p not in our blocks
+      ::operator delete(p);
+   }
+   // n is the size passed to allocate(n)
+   void deallocate(void *p, std::size_t n) {
+      if(within_blocks(p)) {
+         recycle(p);
+         return;
+      }
+      // p not in our blocks
+      ::operator delete(p, n);
+   }
+};
+
+void *operator new (std::size_t n, AdaptiveChunkAllocator &chunks) {
+   return chunks.allocate(n);
+}
+void operator delete (void *p, AdaptiveChunkAllocator &chunks) {
+   return chunks.deallocate(p);
+}
+void operator delete (void *p, std::size_t n, AdaptiveChunkAllocator &chunks) {
+   return chunks.deallocate(p, n);
+}
+void *operator new[] (std::size_t n, AdaptiveChunkAllocator &chunks) {
+   return chunks.allocate(n);
+}
+void operator delete[] (void *p, AdaptiveChunkAllocator &chunks) {
+   return chunks.deallocate(p);
+}
+void operator delete[] (void *p, std::size_t n, AdaptiveChunkAllocator &chunks) {
+   return chunks.deallocate(p, n);
+}
+
+
+//
+// Test program
+//
+
+#include <chrono>
+#include <utility>
+
+template <class F, class ... Args>
+   auto test(F f, Args &&... args) {
+      using namespace std;
+      using namespace std::chrono;
+      auto pre = high_resolution_clock::now();
+      auto res = f(std::forward<Args>(args)...);
+      auto post = high_resolution_clock::now();
+      return pair{ res, post - pre };
+   }
+
+template <int N> struct dummy { char _[N] {}; };
+
+// our traffic: mostly small objects, and some sizes just above powers of two
+template <class Alloc, class Dealloc>
+   auto workload(int n, int nb_rounds, Alloc alloc, Dealloc dealloc) {
+      std::vector<std::pair<void*, std::size_t>> ptrs;
+      ptrs.reserve(n * 6);
+      for(int round = 0; round != nb_rounds; ++round) {
+         for(int i = 0; i != n; ++i) {
+            for(auto sz : { sizeof(dummy<30>), sizeof(dummy<30>), sizeof(dummy<60>),
+                            sizeof(dummy<65>), sizeof(dummy<100>), sizeof(dummy<100>) })
+               ptrs.emplace_back(alloc(sz), sz);
+         }
+         for(auto [p, sz] : ptrs)
+            dealloc(p, sz);
+         ptrs.clear();
+      }
+      return n * 6 * nb_rounds;
+   }
+
+#include <print>
+int main() {
+   using namespace std;
+   using namespace std::chrono;
+   constexpr int N = 100'000;
+   constexpr int NB_ROUNDS = 10;
+   // profiling run
+   SizeProfiler profiler;
+   workload(N / 10, 1,
+            [&profiler](std::size_t n) { return profiler.allocate(n); },
+            [&profiler](void *p, std::size_t n) { profiler.deallocate(p, n); });
+   auto &hist = profiler.histogram();
+   // what the static version would use (ChunkSizedAllocator<N, 32, 62, 128>)
+   vector<size_t> pow2 { 32, 64, 128 };
+   auto learned = learn_size_classes(hist, std::size(pow2));
+   std::print("Power of two classes : {} {} {}, {} bytes wasted\n",
+              pow2[0], pow2[1], pow2[2], internal_fragmentation(hist, pow2));
+   std::print("Learned classes      :");
+   for(auto sz : learned)
+      std::print(" {}", sz);
+   std::print(", {} bytes wasted\n", internal_fragmentation(hist, learned));
+   AdaptiveChunkAllocator chunks{ 2 * N, learned };
+   auto [r0, dt0] = test([] {
+      return workload(N, NB_ROUNDS,
+                      [](std::size_t n) { return ::operator new(n); },
+                      [](void *p, std::size_t n) { ::operator delete(p, n); });
+   });
+   auto [r1, dt1] = test([&chunks] {
+      return workload(N, NB_ROUNDS,
+                      [&chunks](std::size_t n) { return ::operator new(n, chunks); },
+                      [&chunks](void *p, std::size_t n) { ::operator delete(p, n, chunks); });
+   });
+   std::print("Standard version : {} objects in {}\n", r0, duration_cast<microseconds>(dt0));
+   std::print("Adaptive version : {} objects in {}\n", r1, duration_cast<microseconds>(dt1));
+}
@@ -0,0 +1,403 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <vector>
+#include <utility>
+#include <memory>
+#include <cassert>
+#include <concepts>
+#include <limits>
+#include <array>
+#include <iterator>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <cstdint>
+
+template <class T, std::same_as<T> ... Ts>
+   constexpr std::array<T, sizeof...(Ts)+1> make_array(T n, Ts ... ns) {
+      return { n, ns... };
+   }
+
+constexpr bool is_power_of_two(std::integral auto n) {
+   return n && ((n & (n - 1)) == 0);
+}
+
+class integral_value_too_big {};
+
+constexpr auto next_power_of_two(std::integral auto n) {
+   constexpr auto upper_limit = std::numeric_limits<decltype(n)>::max();
+   for(; n != upper_limit && !is_power_of_two(n); ++n)
+       ;
+   if(!is_power_of_two(n)) throw integral_value_too_big{};
+   return n;
+}
+
+template <class T>
+   constexpr bool is_sorted(const T &c) {
+      return std::is_sorted(std::begin(c), std::end(c));
+   }
+
+//
+// variant for producer/consumer workloads: each thread allocates from its
+// own heap, without locking, and chunks freed by another thread than their
+// owner go to the owner's remote-free list for that size class (a lock-free
+// stack, one CAS per push). The owner takes the whole list at once, with a
+// single exchange, when it runs out of local chunks
+//
+template <int N, auto ... Sz>
+   class ChunkSizedAllocator {
+      static_assert(is_sorted(make_array(Sz...)));
+      static_assert(sizeof...(Sz) > 0);
+      static_assert(((Sz >= sizeof(std::max_align_t)) && ...));
+      static_assert(N > 0);
+      static constexpr unsigned long long sizes[] {
+         next_power_of_two(Sz)...
+      };
+      static constexpr std::size_t nb_classes = std::size(sizes);
+      //
+      // sizes are powers of two, hence multiples of sizes[0]; rounding
+      // a request up to a multiple of sizes[0] gives an index in this
+      // table, which holds the smallest size class that fits
+      //
+      static constexpr auto size_class = [] {
+         std::array<std::size_t, sizes[nb_classes - 1] / sizes[0] + 1> table{};
+         for(std::size_t j = 0, i = 0; j != std::size(table); ++j) {
+            while(j * sizes[0] > sizes[i]) ++i;
+            table[j] = i;
+         }
+         return table;
+      }();
+      //
+      // all blocks come from a single allocation, block i starting at
+      // base + i * stride; this wastes address space (not memory, as
+      // untouched pages are not committed) but finding which block
+      // a chunk comes from is a subtraction and a division
+      //
+      static constexpr std::size_t stride = N * sizes[nb_classes - 1];
+      char *base;
+      //
+      // blocks are handed to threads by spans of SPAN chunks; the
+      // thread a span was handed to owns its chunks from then on
+      //
+      static constexpr int SPAN = 64;
+      static constexpr int nb_spans = (N + SPAN - 1) / SPAN;
+      // released chunks, threaded through the chunks themselves
+      // (they are at least sizeof(std::max_align_t) bytes big)
+      struct free_chunk {
+         free_chunk *next;
+      };
+      struct thread_heap {
+         // pushed to by other threads, on their own cache lines
+         struct alignas(std::hardware_destructive_interference_size) remote_list {
+            std::atomic<free_chunk*> head{ nullptr };
+         } remote[nb_classes];
+         // touched by the owner only
+         free_chunk *local[nb_classes] {};
+         char *cur[nb_classes] {};
+         char *end[nb_classes] {};
+      };
+      std::atomic<int> next_span[nb_classes] {};
+      // owners[i * nb_spans + s] owns span s of block i
+      std::vector<thread_heap*> owners;
+      //
+      // heaps are leased to threads, and given back when a thread exits;
+      // the next thread to lease a heap inherits its spans, its local
+      // chunks and its remote-free lists (which it drains as usual), so
+      // that chunks freed to an exited thread are not stranded. Heaps
+      // live as long as the pool, which may outlive the allocator, as
+      // threads may exit after it is destroyed
+      //
+      struct heap_pool {
+         // only locked when a thread leases or gives back a heap
+         std::mutex m;
+         std::vector<std::unique_ptr<thread_heap>> heaps;
+         std::vector<thread_heap*> available;
+         std::atomic<bool> closed{ false }; // the allocator is gone
+         thread_heap *lease() {
+            std::lock_guard _ { m };
+            if(!available.empty()) {
+               auto h = available.back();
+               available.pop_back();
+               return h;
+            }
+            return heaps.emplace_back(std::make_unique<thread_heap>()).get();
+         }
+         void give_back(thread_heap *h) {
+            std::lock_guard _ { m };
+            available.push_back(h);
+         }
+      };
+      std::shared_ptr<heap_pool> pool = std::make_shared<heap_pool>();
+      // distinguishes allocators in the per-thread cache and leases below
+      inline static std::atomic<std::uint64_t> next_uid{ 0 };
+      std::uint64_t uid = next_uid++;
+      struct heap_cache {
+         std::uint64_t uid = ~std::uint64_t{};
+         thread_heap *heap = nullptr;
+      };
+      inline static thread_local heap_cache cache;
+      class heap_lease {
+         std::shared_ptr<heap_pool> from;
+      public:
+         std::uint64_t uid;
+         thread_heap *heap;
+         heap_lease(std::shared_ptr<heap_pool> from, std::uint64_t uid)
+            : from{ std::move(from) }, uid{ uid }, heap{ this->from->lease() } {
+         }
+         heap_lease(heap_lease &&other) noexcept
+            : from{ std::move(other.from) }, uid{ other.uid }, heap{ other.heap } {
+         }
+         heap_lease &operator=(heap_lease &&other) noexcept {
+            heap_lease{ std::move(other) }.swap(*this);
+            return *this;
+         }
+         void swap(heap_lease &other) noexcept {
+            using std::swap;
+            swap(from, other.from);
+            swap(uid, other.uid);
+            swap(heap, other.heap);
+         }
+         bool expired() const noexcept {
+            return from->closed.load(std::memory_order_relaxed);
+         }
+         ~heap_lease() {
+            if(!from) return;
+            // the heap may go to another thread from now on
+            if(cache.heap == heap) cache = {};
+            from->give_back(heap);
+         }
+      };
+      inline static thread_local std::vector<heap_lease> leases;
+      thread_heap &my_heap() {
+         if(cache.uid != uid) {
+            auto p = std::find_if(std::begin(leases), std::end(leases), [this](auto &l) {
+               return l.uid == uid;
+            });
+            if(p == std::end(leases)) {
+               // leases of destroyed allocators are not needed anymore
+               std::erase_if(leases, [](auto &l) { return l.expired(); });
+               p = leases.emplace(std::end(leases), pool, uid);
+            }
+            cache = { uid, p->heap };
+         }
+         return *cache.heap;
+      }
+      bool within_blocks(void *p) const {
+         return !std::less{}(p, base) &&
+                std::less{}(p, base + nb_classes * stride);
+      }
+      // a chunk of class i, or nullptr if block i is exhausted
+      void *take(thread_heap &h, std::size_t i) {
+         if(h.local[i])
+            return std::exchange(h.local[i], h.local[i]->next);
+         // the chunks freed by other threads, all at once
+         if(auto q = h.remote[i].head.exchange(nullptr, std::memory_order_acquire)) {
+            h.local[i] = q->next;
+            return q;
+         }
+         if(h.cur[i] == h.end[i]) {
+            // checking first keeps next_span from growing without bounds
+            if(next_span[i].load(std::memory_order_relaxed) >= nb_spans)
+               return nullptr;
+            auto s = next_span[i].fetch_add(1, std::memory_order_relaxed);
+            if(s >= nb_spans)
+               return nullptr;
+            owners[i * nb_spans + s] = &h;
+            h.cur[i] = base + i * stride + s * SPAN * sizes[i];
+            h.end[i] = base + i * stride + std::min(N, (s + 1) * SPAN) * sizes[i];
+         }
+         return std::exchange(h.cur[i], h.cur[i] + sizes[i]);
+      }
+      // precondition: within_blocks(p)
+      void recycle(void *p) {
+         auto offset = static_cast<std::size_t>(static_cast<char*>(p) - base);
+         auto i = offset / stride;
+         auto owner = owners[i * nb_spans + offset % stride / sizes[i] / SPAN];
+         auto q = ::new (p) free_chunk{ nullptr };
+         if(cache.uid == uid && cache.heap == owner) {
+            q->next = owner->local[i];
+            owner->local[i] = q;
+         } else {
+            auto &head = owner->remote[i].head;
+            q->next = head.load(std::memory_order_relaxed);
+            while(!head.compare_exchange_weak(q->next, q, std::memory_order_release,
+                                                          std::memory_order_relaxed))
+               ;
+         }
+      }
+   public:
+      ChunkSizedAllocator(const ChunkSizedAllocator&) = delete;
+      ChunkSizedAllocator& operator=(const ChunkSizedAllocator&) = delete;
+      ChunkSizedAllocator()
+         : base{ static_cast<char*>(std::malloc(nb_classes * stride)) },
+           owners(nb_classes * nb_spans) {
+         assert(base);
+      }
+      ~ChunkSizedAllocator() {
+         pool->closed = true;
+         std::free(base);
+      }
+      // number of heaps handed out so far; bounded by the number of
+      // threads using the allocator at the same time
+      std::size_t nb_heaps() {
+         std::lock_guard _ { pool->m };
+         return std::size(pool->heaps);
+      }
+      auto allocate(std::size_t n) {
+         if(n <= sizes[nb_classes - 1]) {
+            auto &h = my_heap();
+            // use smallest block available
+            for(auto i = size_class[(n + sizes[0] - 1) / sizes[0]]; i != nb_classes; ++i)
+               if(auto p = take(h, i))
+                  return p;
+         }
+         // either no block fits or no block left
+         return ::operator new(n);
+      }
+      void deallocate(void *p) {
+         if(within_blocks(p)) {
+            recycle(p);
+            return;
+         }
+         // p not in our blocks
+         ::operator delete(p);
+      }
+      // n is the size passed to allocate(n)
+      void deallocate(void *p, std::size_t n) {
+         if(within_blocks(p)) {
+            recycle(p);
+            return;
+         }
+         // p not in our blocks
+         ::operator delete(p, n);
+      }
+   };
+
+template <int N, auto ... Sz>
+   void *operator new (std::size_t n, ChunkSizedAllocator<N, Sz...> &chunks) {
+      return chunks.allocate(n);
+   }
+template <int N, auto ... Sz>
+   void operator delete (void *p, ChunkSizedAllocator<N, Sz...> &chunks) {
+      return chunks.deallocate(p);
+   }
+template <int N, auto ... Sz>
+   void operator delete (void *p, std::size_t n, ChunkSizedAllocator<N, Sz...> &chunks) {
+      return chunks.deallocate(p, n);
+   }
+template <int N, auto ... Sz>
+   void *operator new[] (std::size_t n, ChunkSizedAllocator<N, Sz...> &chunks) {
+      return chunks.allocate(n);
+   }
+template <int N, auto ... Sz>
+   void operator delete[] (void *p, ChunkSizedAllocator<N, Sz...> &chunks) {
+      return chunks.deallocate(p);
+   }
+template <int N, auto ... Sz>
+   void operator delete[] (void *p, std::size_t n, ChunkSizedAllocator<N, Sz...> &chunks) {
+      return chunks.deallocate(p, n);
+   }
+
+
+//
+// Test program
+//
+
+#include <chrono>
+#include <utility>
+
+template <class F, class ... Args>
+   auto test(F f, Args &&... args) {
+      using namespace std;
+      using namespace std::chrono;
+      auto pre = high_resolution_clock::now();
+      auto res = f(std::forward<Args>(args)...);
+      auto post = high_resolution_clock::now();
+      return pair{ res, post - pre };
+   }
+
+template <int N> struct dummy { char _[N] {}; };
+
+#include <barrier>
+#include <print>
+#include <vector>
+
+//
+// NB_PAIRS producers allocate batches of objects that NB_PAIRS
+// consumers free, for NB_ROUNDS rounds; every deallocation is
+// made by another thread than the one that allocated
+//
+template <class Alloc, class Dealloc>
+   auto pipeline(int nb_pairs, int nb_rounds, int batch_size, Alloc alloc, Dealloc dealloc) {
+      std::vector<std::vector<std::pair<void*, std::size_t>>> batches(nb_pairs);
+      for(auto &b : batches)
+         b.reserve(batch_size * 3);
+      std::barrier sync(nb_pairs * 2);
+      {
+         std::vector<std::jthread> th;
+         for(int t = 0; t != nb_pairs; ++t) {
+            th.emplace_back([&, &batch = batches[t]] { // producer
+               for(int r = 0; r != nb_rounds; ++r) {
+                  for(int i = 0; i != batch_size; ++i) {
+                     batch.emplace_back(alloc(sizeof(dummy<30>)), sizeof(dummy<30>));
+                     batch.emplace_back(alloc(sizeof(dummy<60>)), sizeof(dummy<60>));
+                     batch.emplace_back(alloc(sizeof(dummy<100>)), sizeof(dummy<100>));
+                  }
+                  sync.arrive_and_wait(); // batch ready
+                  sync.arrive_and_wait(); // batch consumed
+               }
+            });
+            th.emplace_back([&, &batch = batches[t]] { // consumer
+               for(int r = 0; r != nb_rounds; ++r) {
+                  sync.arrive_and_wait(); // batch ready
+                  for(auto [p, n] : batch)
+                     dealloc(p, n);
+                  batch.clear();
+                  sync.arrive_and_wait(); // batch consumed
+               }
+            });
+         }
+      }
+      return nb_pairs * nb_rounds * batch_size * 3;
+   }
+
+int main() {
+   using namespace std;
+   using namespace std::chrono;
+   constexpr int N = 100'000;
+   using Alloc = ChunkSizedAllocator<N, 32, 62 /* 64 */, 128>;
+   Alloc chunks; // construct the ChunkSizedAllocator
+   const int nb_pairs = std::max(1u, std::thread::hardware_concurrency() / 2);
+   constexpr int NB_ROUNDS = 100;
+   const int batch_size = N / 2 / nb_pairs;
+   auto [r0, dt0] = test([&] {
+      return pipeline(nb_pairs, NB_ROUNDS, batch_size,
+                      [](std::size_t n) { return ::operator new(n); },
+                      [](void *p, std::size_t n) { ::operator delete(p, n); });
+   });
+   auto [r1, dt1] = test([&] {
+      return pipeline(nb_pairs, NB_ROUNDS, batch_size,
+                      [&chunks](std::size_t n) { return ::operator new(n, chunks); },
+                      [&chunks](void *p, std::size_t n) { ::operator delete(p, n, chunks); });
+   });
+   std::print("{} producer/consumer pair(s), {} objects\n", nb_pairs, r0);
+   std::print("Standard version : {}\n", duration_cast<microseconds>(dt0));
+   std::print("Chunked version  : {}\n", duration_cast<microseconds>(dt1));
+   //
+   // each run has new threads; they lease the heaps of the threads of
+   // the previous runs, chunks freed to those included
+   //
+   constexpr int NB_RUNS = 5;
+   auto [r2, dt2] = test([&] {
+      int n = 0;
+      for(int i = 0; i != NB_RUNS; ++i)
+         n += pipeline(nb_pairs, NB_ROUNDS, batch_size,
+                       [&chunks](std::size_t n) { return ::operator new(n, chunks); },
+                       [&chunks](void *p, std::size_t n) { ::operator delete(p, n, chunks); });
+      return n;
+   });
+   std::print("Chunked version, {} more runs with new threads : {}, {} heaps\n",
+              NB_RUNS, duration_cast<microseconds>(dt2), chunks.nb_heaps());
+}
@@ -1,6 +1,9 @@
 // also available live: https://wandbox.org/permlink/MtdPNejNOAvbOBNq
 
 #include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
 #include <vector>
 #include <utility>
 #include <memory>
@@ -10,6 +13,7 @@
 #include <array>
 #include <iterator>
 #include <mutex>
+#include <atomic>
 
 template <class T, std::same_as<T> ... Ts>
    constexpr std::array<T, sizeof...(Ts)+1> make_array(T n, Ts ... ns) {
@@ -35,6 +39,36 @@ template <class T>
       return std::is_sorted(std::begin(c), std::end(c));
    }
 
+//
+// occupancy statistics; the counters are only written under
+// a lock, but can be read at any time without it
+//
+struct arena_stats {
+   std::size_t bytes_reserved;
+   std::size_t bytes_in_use;
+   std::size_t high_water_mark;
+   std::size_t free_list_length;
+};
+
+class stat_counter {
+   std::atomic<std::size_t> n{ 0 };
+public:
+   // single writer (the lock holder): no need for a read-modify-write
+   void add(std::size_t k) noexcept {
+      n.store(n.load(std::memory_order_relaxed) + k, std::memory_order_relaxed);
+   }
+   void sub(std::size_t k) noexcept {
+      n.store(n.load(std::memory_order_relaxed) - k, std::memory_order_relaxed);
+   }
+   void raise_to(std::size_t k) noexcept {
+      if(k > n.load(std::memory_order_relaxed))
+         n.store(k, std::memory_order_relaxed);
+   }
+   std::size_t get() const noexcept {
+      return n.load(std::memory_order_relaxed);
+   }
+};
+
 template <int N, auto ... Sz>
    class ChunkSizedAllocator {
       static_assert(is_sorted(make_array(Sz...)));
@@ -44,55 +78,138 @@ template <int N, auto ... Sz>
       static constexpr unsigned long long sizes[] {
          next_power_of_two(Sz)...
       };
-      using raw_ptr = void*;
-      raw_ptr blocks[sizeof...(Sz)];
-      int cur[sizeof...(Sz)] {}; // initialized to zero
-      bool within_block(void *p, int i) {
-         void* b = blocks[i];
-         void* e = static_cast<char*>(b) + N * sizes[i];
-         return p == b ||
-                (std::less{}(b, p) && std::less{}(p, e));
-      }
-      std::mutex m;
+      static constexpr std::size_t nb_classes = std::size(sizes);
+      //
+      // sizes are powers of two, hence multiples of sizes[0]; rounding
+      // a request up to a multiple of sizes[0] gives an index in this
+      // table, which holds the smallest size class that fits
+      //
+      static constexpr auto size_class = [] {
+         std::array<std::size_t, sizes[nb_classes - 1] / sizes[0] + 1> table{};
+         for(std::size_t j = 0, i = 0; j != std::size(table); ++j) {
+            while(j * sizes[0] > sizes[i]) ++i;
+            table[j] = i;
+         }
+         return table;
+      }();
+      //
+      // all blocks come from a single allocation, block i starting at
+      // base + i * stride; this wastes address space (not memory, as
+      // untouched pages are not committed) but finding which block
+      // a chunk comes from is a subtraction and a division
+      //
+      static constexpr std::size_t stride = N * sizes[nb_classes - 1];
+      char *base;
+      // each size class has its own lock, on its own cache line
+      struct alignas(std::hardware_destructive_interference_size) chunk_class {
+         std::mutex m;
+         int cur = 0;
+         // released chunks, threaded through the chunks themselves
+         // (they are at least sizeof(std::max_align_t) bytes big)
+         struct free_chunk { free_chunk *next; } *free = nullptr;
+         // counted in chunks
+         stat_counter in_use, high_water, free_length;
+         // precondition: m is locked
+         void taken() noexcept {
+            in_use.add(1);
+            high_water.raise_to(in_use.get());
+         }
+      };
+      chunk_class classes[nb_classes];
+      // requests served by ::operator new
+      std::atomic<std::size_t> nb_fallbacks{ 0 };
+      bool within_blocks(void *p) const {
+         return !std::less{}(p, base) &&
+                std::less{}(p, base + nb_classes * stride);
+      }
+      std::size_t block_of(void *p) const {
+         return (static_cast<char*>(p) - base) / stride;
+      }
+      // precondition: within_blocks(p)
+      void recycle(void *p) {
+         auto &c = classes[block_of(p)];
+         std::lock_guard _ { c.m };
+         c.free = ::new (p) typename chunk_class::free_chunk{ c.free };
+         c.free_length.add(1);
+         c.in_use.sub(1);
+      }
    public:
       ChunkSizedAllocator(const ChunkSizedAllocator&) = delete;
       ChunkSizedAllocator& operator=(const ChunkSizedAllocator&) = delete;
-      ChunkSizedAllocator() {
-         int i = 0;
-         for(auto sz : sizes)
-            blocks[i++] = std::malloc(N * sz);
-         assert(std::none_of(std::begin(blocks), std::end(blocks), [](auto p) { return !p; }));
+      ChunkSizedAllocator()
+         : base{ static_cast<char*>(std::malloc(nb_classes * stride)) } {
+         assert(base);
       }
       ~ChunkSizedAllocator() {
-         for(auto p : blocks)
-            std::free(p);
+         std::free(base);
       }
       auto allocate(std::size_t n) {
-         // use smallest block available
-         for(std::size_t i = 0; i != std::size(sizes); ++i) {
-            if(n < sizes[i]) {
-               std::lock_guard _ { m };
-               if(cur[i] < N) {
-                  void *p = static_cast<char*>(blocks[i]) + cur[i] * sizes[i];
-                  ++cur[i];
-                  return p;
+         if(n <= sizes[nb_classes - 1]) {
+            // use smallest block available
+            for(auto i = size_class[(n + sizes[0] - 1) / sizes[0]]; i != nb_classes; ++i) {
+               auto &c = classes[i];
+               std::lock_guard _ { c.m };
+               if(c.free) {
+                  c.free_length.sub(1);
+                  c.taken();
+                  return static_cast<void*>(std::exchange(c.free, c.free->next));
+               }
+               if(c.cur < N) {
+                  c.taken();
+                  return static_cast<void*>(base + i * stride + c.cur++ * sizes[i]);
                }
             }
          }
          // either no block fits or no block left
+         nb_fallbacks.fetch_add(1, std::memory_order_relaxed);
          return ::operator new(n);
       }
       void deallocate(void *p) {
-         for(std::size_t i = 0; i != std::size(sizes); ++i) {
-            if(within_block(p, i)) {
-               //std::lock_guard _ { m };
-               // if you want to reuse the memory, it's in blocks[i]
-               return;
-            }
+         if(within_blocks(p)) {
+            recycle(p);
+            return;
          }
          // p not in our blocks
          ::operator delete(p);
       }
+      // n is the size passed to allocate(n)
+      void deallocate(void *p, std::size_t n) {
+         if(within_blocks(p)) {
+            recycle(p);
+            return;
+         }
+         // p not in our blocks
+         ::operator delete(p, n);
+      }
+      static constexpr std::size_t size_classes() noexcept {
+         return nb_classes;
+      }
+      static constexpr std::size_t chunk_size(std::size_t i) noexcept {
+         return sizes[i];
+      }
+      // occupancy of size class i
+      arena_stats stats(std::size_t i) const noexcept {
+         auto &c = classes[i];
+         return {
+            N * sizes[i], c.in_use.get() * sizes[i], c.high_water.get() * sizes[i], c.free_length.get()
+         };
+      }
+      // all size classes together; as classes peak at different
+      // times, the high-water mark is an upper bound
+      arena_stats stats() const noexcept {
+         arena_stats total {};
+         for(std::size_t i = 0; i != nb_classes; ++i) {
+            auto st = stats(i);
+            total.bytes_reserved += st.bytes_reserved;
+            total.bytes_in_use += st.bytes_in_use;
+            total.high_water_mark += st.high_water_mark;
+            total.free_list_length += st.free_list_length;
+         }
+         return total;
+      }
+      std::size_t fallbacks() const noexcept {
+         return nb_fallbacks.load(std::memory_order_relaxed);
+      }
    };
 
 template <int N, auto ... Sz>
@@ -103,7 +220,22 @@ template <int N, auto ... Sz>
    void operator delete (void *p, ChunkSizedAllocator<N, Sz...> &chunks) {
       return chunks.deallocate(p);
    }
-// new[] and delete[] left as an exercise ;)
+template <int N, auto ... Sz>
+   void operator delete (void *p, std::size_t n, ChunkSizedAllocator<N, Sz...> &chunks) {
+      return chunks.deallocate(p, n);
+   }
+template <int N, auto ... Sz>
+   void *operator new[] (std::size_t n, ChunkSizedAllocator<N, Sz...> &chunks) {
+      return chunks.allocate(n);
+   }
+template <int N, auto ... Sz>
+   void operator delete[] (void *p, ChunkSizedAllocator<N, Sz...> &chunks) {
+      return chunks.deallocate(p);
+   }
+template <int N, auto ... Sz>
+   void operator delete[] (void *p, std::size_t n, ChunkSizedAllocator<N, Sz...> &chunks) {
+      return chunks.deallocate(p, n);
+   }
 
 
 //
@@ -169,6 +301,51 @@ int main() {
          p.second(p.first);
       return std::size(ptrs);
    });
+   //
+   // long-running use: many rounds, hence far more than N allocations
+   // per size class, which only stay within the chunks if released
+   // chunks are reused. The 60-byte objects are arrays, through new[]
+   //
+   constexpr int NB_ROUNDS = 10;
+   auto [r2, dt2] = test([ptrs = std::vector<void*>(N * 3)]() mutable {
+      for(int round = 0; round != NB_ROUNDS; ++round) {
+         for(int i = 0; i != N * 3; i += 3) {
+            ptrs[i] = new dummy<30>{};
+            ptrs[i + 1] = new dummy<10>[6]{};
+            ptrs[i + 2] = new dummy<100>{};
+         }
+         for(int i = 0; i != N * 3; i += 3) {
+            delete static_cast<dummy<30>*>(ptrs[i]);
+            delete [] static_cast<dummy<10>*>(ptrs[i + 1]);
+            delete static_cast<dummy<100>*>(ptrs[i + 2]);
+         }
+      }
+      return NB_ROUNDS * std::size(ptrs);
+   });
+   auto [r3, dt3] = test([&chunks, ptrs = std::vector<void*>(N * 3)]() mutable {
+      for(int round = 0; round != NB_ROUNDS; ++round) {
+         for(int i = 0; i != N * 3; i += 3) {
+            ptrs[i] = new (chunks) dummy<30>{};
+            ptrs[i + 1] = new (chunks) dummy<10>[6]{};
+            ptrs[i + 2] = new (chunks) dummy<100>{};
+         }
+         // dummy<N> is trivially destructible, no destructor to call
+         for(int i = 0; i != N * 3; i += 3) {
+            ::operator delete(ptrs[i], sizeof(dummy<30>), chunks);
+            ::operator delete[](ptrs[i + 1], sizeof(dummy<10>[6]), chunks);
+            ::operator delete(ptrs[i + 2], sizeof(dummy<100>), chunks);
+         }
+      }
+      return NB_ROUNDS * std::size(ptrs);
+   });
    std::print("Standard version : {}\n", duration_cast<microseconds>(dt0));
    std::print("Chunked version  : {}\n", duration_cast<microseconds>(dt1));
+   std::print("Standard version, {} rounds : {}\n", NB_ROUNDS, duration_cast<microseconds>(dt2));
+   std::print("Chunked version, {} rounds  : {}\n", NB_ROUNDS, duration_cast<microseconds>(dt3));
+   for(std::size_t i = 0; i != Alloc::size_classes(); ++i) {
+      auto st = chunks.stats(i);
+      std::print("Chunks of {:>3} bytes: {} bytes reserved, {} in use, high-water mark {}, {} free\n",
+                 Alloc::chunk_size(i), st.bytes_reserved, st.bytes_in_use, st.high_water_mark, st.free_list_length);
+   }
+   std::print("Requests served by ::operator new: {}\n", chunks.fallbacks());
 }
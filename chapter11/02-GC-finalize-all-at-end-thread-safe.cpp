@@ -4,6 +4,9 @@
 #include <memory>
 #include <print>
 #include <mutex>
+#include <thread>
+#include <chrono>
+#include <algorithm>
 
 //
 // use-case : destroy all GcNodes when GC object is destroyed, calling the proper dtors
@@ -33,16 +36,55 @@ class GC {
          destroy(get());
       }
    };
-   std::vector<std::unique_ptr<GcRoot>> roots;
+   //
+   // roots are sharded: each thread appends to a shard of its own,
+   // without locking. A thread that ends hands its shard back, for
+   // another thread to reuse; the roots in there stay alive until
+   // the GC is destroyed. m only protects the lists of shards
+   //
+   struct shard {
+      std::vector<std::unique_ptr<GcRoot>> roots;
+   };
+   std::vector<std::unique_ptr<shard>> shards;
+   std::vector<shard*> available;
+   class shard_lease {
+      shard *s;
+   public:
+      shard_lease() : s{ GC::get().acquire_shard() } {
+      }
+      shard_lease(const shard_lease&) = delete;
+      shard_lease& operator=(const shard_lease&) = delete;
+      ~shard_lease() {
+         GC::get().release_shard(s);
+      }
+      shard &get() noexcept { return *s; }
+   };
    GC() = default;
-   static auto &get() {
+   static GC &get() {
       static GC gc;
       return gc;
    }
+   shard *acquire_shard() {
+      std::lock_guard _ { m };
+      if (!available.empty()) {
+         auto s = available.back();
+         available.pop_back();
+         return s;
+      }
+      return shards.emplace_back(std::make_unique<shard>()).get();
+   }
+   void release_shard(shard *s) {
+      std::lock_guard _ { m };
+      available.push_back(s);
+   }
+   // this thread's shard
+   static shard &local_shard() {
+      thread_local shard_lease lease;
+      return lease.get();
+   }
    template <class T, class ... Args>
       T *add_root(Args &&... args) {
-         std::lock_guard _ { m };
-         return static_cast<T*>(roots.emplace_back(
+         return static_cast<T*>(local_shard().roots.emplace_back(
             std::make_unique<GcNode<T>>(std::forward<Args>(args)...)
          )->get());
       }
@@ -85,8 +127,27 @@ auto f() {
    return h();
 }
 
+// each thread allocates in its own shard
+auto allocate_in_parallel(unsigned nb_threads, int nb_per_thread) {
+   using namespace std::chrono;
+   auto pre = steady_clock::now();
+   {
+      std::vector<std::jthread> th;
+      for (unsigned i = 0; i != nb_threads; ++i)
+         th.emplace_back([nb_per_thread] {
+            for (int j = 0; j != nb_per_thread; ++j)
+               gcnew<int>(j);
+         });
+   }
+   return duration_cast<microseconds>(steady_clock::now() - pre);
+}
+
 int main() {
    std::print("Pre\n");
    std::print("{}\n", f()->m());
+   constexpr int NB_PER_THREAD = 100'000;
+   auto nb_threads = std::max(std::thread::hardware_concurrency(), 1u);
+   auto dt = allocate_in_parallel(nb_threads, NB_PER_THREAD);
+   std::print("{} threads, {} objects each, in {}\n", nb_threads, NB_PER_THREAD, dt);
    std::print("Post\n");
 }
@@ -5,28 +5,70 @@
 #include <string>
 #include <iostream>
 #include <atomic>
-#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <stop_token>
+#include <thread>
+#include <type_traits>
+#include <exception>
 #include <utility>
+#include <chrono>
+#include <limits>
+#include <iterator>
+#include <algorithm>
+#include <random>
 
 //
 // use-case : destroy all GcNodes when collecting, calling the proper dtors
 //
 // using counting_ptr to know which objects to collect
 //
-template <class T>
+
+//
+// threading policies: the type of the counts, the mutex that protects
+// the GC, and whether each thread has a GC of its own. A GC whose objects
+// stay with the thread that uses it can do with plain counts (copying a
+// counting_ptr is then an ordinary increment, not a locked
+// read-modify-write) and without locking, as no other thread sees it
+//
+struct thread_confined {
+   static constexpr bool per_thread = true;
+   using count_type = int;
+   struct mutex_type {
+      void lock() noexcept {
+      }
+      void unlock() noexcept {
+      }
+   };
+};
+struct thread_safe {
+   static constexpr bool per_thread = false;
+   using count_type = std::atomic<int>;
+   using mutex_type = std::mutex;
+};
+
+//
+// the object a counting_ptr points to lives in a control block, along
+// with its count (one allocation, one cache line touched when copying
+// a counting_ptr); the block is told through mark(), which does not
+// allocate, when the count reaches zero
+//
+template <class Policy>
+   struct control_block {
+      using count_type = typename Policy::count_type;
+      count_type count{ 1 };
+      virtual void mark() noexcept = 0;
+      virtual ~control_block() = default;
+   };
+
+template <class T, class Policy = thread_confined>
    class counting_ptr {
-      using count_type = std::atomic<int>;
       T *p;
-      count_type *count;
-      std::function<void()> mark;
+      control_block<Policy> *ctl;
    public:
-      template <class M>
-         constexpr counting_ptr(T *p, M mark) try : p{ p }, mark{ mark } {
-            count = new count_type{ 1 };
-         } catch(...) {
-            delete p;
-            throw;
-         }
+      // ctl's count already accounts for this counting_ptr
+      constexpr counting_ptr(T *p, control_block<Policy> *ctl) noexcept : p{ p }, ctl{ ctl } {
+      }
       T& operator*() noexcept {
          return *p;
       }
@@ -46,11 +88,11 @@ template <class T>
          return !(*this == other);
       }
       template <class U>
-         constexpr bool operator==(const counting_ptr<U> &other) const {
+         constexpr bool operator==(const counting_ptr<U, Policy> &other) const {
             return p == &*other;
          }
       template <class U>
-         constexpr bool operator!=(const counting_ptr<U> &other) const {
+         constexpr bool operator!=(const counting_ptr<U, Policy> &other) const {
             return !(*this == other);
          }
       template <class U>
@@ -64,130 +106,363 @@ template <class T>
       void swap(counting_ptr &other) {
          using std::swap;
          swap(p, other.p);
-         swap(count, other.count);
-         swap(mark, other.mark);
+         swap(ctl, other.ctl);
       }
       constexpr operator bool() const noexcept {
          return p != nullptr;
       }
       counting_ptr(counting_ptr &&other) noexcept
          : p{ std::exchange(other.p, nullptr) },
-           count{ std::exchange(other.count, nullptr) },
-           mark{ other.mark } {
+           ctl{ std::exchange(other.ctl, nullptr) } {
       }
       counting_ptr &operator=(counting_ptr &&other) noexcept {
          counting_ptr{ std::move(other) }.swap(*this);
          return *this;
       }
       counting_ptr(const counting_ptr &other)
-         : p{ other.p }, count{ other.count }, mark{ other.mark } {
-         if (count) ++(*count);
+         : p{ other.p }, ctl{ other.ctl } {
+         if (ctl) ++ctl->count;
       }
       counting_ptr &operator=(const counting_ptr &other) {
          counting_ptr{ other }.swap(*this);
          return *this;
       }
       ~counting_ptr() {
-         if (count) {
-            if ((*count)-- == 1) {
-               // delete p;
-               mark();
-               delete count;
-            }
-         }
+         if (ctl && ctl->count-- == 1)
+            ctl->mark();
       }
    };
 namespace std {
-   template <class T, class M>
-      void swap(counting_ptr<T> &a, counting_ptr<T> &b) {
+   template <class T, class P>
+      void swap(counting_ptr<T, P> &a, counting_ptr<T, P> &b) {
          a.swap(b);
       }
 }
 
-class GC {
-   class GcRoot {
-      void *p;
+//
+// how much a collection may finalize: at most max_objects roots, in
+// (about) max_time; at least one root is finalized if there is any,
+// so that collection always progresses, even with a zero budget. The
+// default is no limit
+//
+struct collect_budget {
+   std::size_t max_objects = std::numeric_limits<std::size_t>::max();
+   std::chrono::nanoseconds max_time = std::chrono::nanoseconds::max();
+};
+
+//
+// tells whether the destructor of T may run on another thread, at the
+// same time as destructors of other objects, in no particular order.
+// Only objects of a thread_safe GC qualify, as such destructors may
+// release counting_ptrs. Objects of other types are finalized in order,
+// by the collecting thread
+//
+template <class T>
+   struct parallel_finalization : std::false_type {
+   };
+
+//
+// a few threads that finalize alongside the collecting thread: one per
+// core besides the caller's, started when first needed
+//
+class finalizer_pool {
+   using job_type = void (*)(void*) noexcept;
+   std::mutex m;
+   std::condition_variable_any wakeup;
+   std::condition_variable done;
+   job_type job = nullptr;
+   void *job_arg = nullptr;
+   std::size_t generation = 0;
+   std::size_t nb_running = 0;
+   // one job at a time
+   std::mutex running;
+   // set while this thread runs a job
+   static inline thread_local bool in_job = false;
+   // last, as the threads have to stop before the rest goes away
+   std::vector<std::jthread> workers;
+   finalizer_pool() {
+      auto n = std::max(std::thread::hardware_concurrency(), 1u) - 1;
+      for (unsigned i = 0; i != n; ++i)
+         workers.emplace_back([this](std::stop_token st) { work(st); });
+   }
+   void work(std::stop_token st) {
+      for (std::size_t seen = 0; ; ) {
+         std::unique_lock lck{ m };
+         if (!wakeup.wait(lck, st, [&] { return generation != seen; }))
+            return;
+         seen = generation;
+         auto f = job;
+         auto arg = job_arg;
+         lck.unlock();
+         in_job = true;
+         f(arg);
+         in_job = false;
+         lck.lock();
+         if (--nb_running == 0)
+            done.notify_one();
+      }
+   }
+public:
+   finalizer_pool(const finalizer_pool &) = delete;
+   finalizer_pool& operator=(const finalizer_pool &) = delete;
+   static finalizer_pool &get() {
+      static finalizer_pool pool;
+      return pool;
+   }
+   // number of threads a job runs on, the caller's included
+   std::size_t size() const noexcept {
+      return std::size(workers) + 1;
+   }
+   // whether the calling thread is running a job, and cannot start
+   // another one (the pool would wait for itself)
+   static bool busy() noexcept {
+      return in_job;
+   }
+   // runs f(arg) on each thread of the pool and on the calling one,
+   // then waits for them all; f shares the work out by itself.
+   // Precondition: !busy()
+   void run(job_type f, void *arg) {
+      std::lock_guard one_job{ running };
+      {
+         std::lock_guard _ { m };
+         job = f;
+         job_arg = arg;
+         ++generation;
+         nb_running = std::size(workers);
+      }
+      wakeup.notify_all();
+      in_job = true;
+      f(arg);
+      in_job = false;
+      std::unique_lock lck{ m };
+      done.wait(lck, [this] { return nb_running == 0; });
+   }
+};
+
+template <class Policy>
+   class basic_GC;
+template <class Policy>
+   struct basic_scoped_collect;
+template <class T, class Policy = thread_confined, class ... Args>
+   counting_ptr<T, Policy> gcnew(Args &&...);
+
+template <class Policy>
+class basic_GC {
+   class GcRoot;
+   // destroys the nodes in [first, last), all of the same type, and
+   // leaves null pointers behind; doubles as an identifier for that type
+   using finalizer = void (*)(std::unique_ptr<GcRoot>*, std::unique_ptr<GcRoot>*) noexcept;
+   // the longest run of same-typed nodes finalized in one call; the
+   // time budget of a collection is checked between two such runs
+   static constexpr std::size_t FINALIZE_BATCH = 64;
+   // the number of nodes a thread of the pool finalizes at a time
+   static constexpr std::size_t PARALLEL_CHUNK = 1'024;
+   class GcRoot : public control_block<Policy> {
    public:
-      auto get() const noexcept { return p; }
-      GcRoot(void *p) : p{ p } {
+      // the GC this root belongs to
+      basic_GC *owner;
+      // position of this root in roots, kept up to date by collect()
+      std::size_t index;
+      finalizer finalize;
+      // see parallel_finalization
+      bool parallel;
+      // next in the list of collectable roots
+      GcRoot *next = nullptr;
+      GcRoot(basic_GC *owner, std::size_t index, finalizer finalize, bool parallel)
+         : owner{ owner }, index{ index }, finalize{ finalize }, parallel{ parallel } {
       }
       GcRoot(const GcRoot&) = delete;
       GcRoot& operator=(const GcRoot&) = delete;
-      virtual void destroy(void*) const noexcept = 0;
-      virtual ~GcRoot() = default;
+      void mark() noexcept override {
+         basic_GC::get().make_collectable(this);
+      }
    };
-   template <class T> class GcNode : public GcRoot {
-      void destroy(void *q) const noexcept override {
-         delete static_cast<T*>(q);
+   // the object is stored in the node itself
+   template <class T> class GcNode final : public GcRoot {
+      T obj;
+      // the pool's threads have no business with a thread_confined GC
+      static_assert(!parallel_finalization<T>::value || std::is_same_v<Policy, thread_safe>,
+                    "parallel finalization requires a thread_safe GC");
+      // GcNode being final, the destructor calls are not virtual
+      static void finalize_all(std::unique_ptr<GcRoot> *first, std::unique_ptr<GcRoot> *last) noexcept {
+         for (; first != last; ++first)
+            delete static_cast<GcNode*>(first->release());
       }
    public:
       template <class ... Args>
-         GcNode(Args &&... args) : GcRoot(new T(std::forward<Args>(args)...)) {
+         GcNode(basic_GC *owner, std::size_t index, Args &&... args)
+            : GcRoot{ owner, index, finalize_all, parallel_finalization<T>::value }, obj(std::forward<Args>(args)...) {
          }
-      ~GcNode() {
-         destroy(get());
+      T *get() noexcept {
+         return &obj;
       }
    };
-   std::vector<std::pair<std::unique_ptr<GcRoot>, bool>> roots;
-   GC() = default;
-   static auto &get() {
-      static GC gc;
-      return gc;
-   }
-   void make_collectable(void *p) {
-      for (auto &[q, coll] : roots)
-         if (static_cast<GcRoot*>(p) == q.get())
-            coll = true;
-   }
-   void collect() {
-      for (auto p = std::begin(roots); p != std::end(roots); ) {
-         if (auto &[ptr, collectible] = *p; collectible) {
-            ptr = nullptr;
-            p = roots.erase(p);
-         } else {
+   std::vector<std::unique_ptr<GcRoot>> roots;
+   // the roots whose counting_ptr count reached zero, in that order
+   // (intrusive list, appended to at its end)
+   GcRoot *collectable = nullptr;
+   GcRoot **collectable_end = &collectable;
+   std::size_t nb_collectable = 0;
+   // taken out of roots, but left to finalize by a budgeted collection
+   std::vector<std::unique_ptr<GcRoot>> pending;
+   // protects all of the above
+   typename Policy::mutex_type m;
+   basic_GC() = default;
+   static basic_GC &get() {
+      if constexpr (Policy::per_thread) {
+         thread_local basic_GC gc;
+         return gc;
+      } else {
+         static basic_GC gc;
+         return gc;
+      }
+   }
+   // [first, last) may hold nodes of different types
+   static void finalize_runs(std::unique_ptr<GcRoot> *first, std::unique_ptr<GcRoot> *last) noexcept {
+      while (first != last) {
+         auto f = (*first)->finalize;
+         auto p = first + 1;
+         while (p != last && (*p)->finalize == f)
             ++p;
+         f(first, p);
+         first = p;
+      }
+   }
+   // the threads of the pool take chunks of [first, last) in turn; those
+   // not started by the deadline are left alone, except the first one if
+   // nothing was finalized yet
+   static void finalize_in_parallel(std::unique_ptr<GcRoot> *first, std::unique_ptr<GcRoot> *last,
+                                    std::chrono::steady_clock::time_point deadline, bool progressed) {
+      struct job {
+         std::unique_ptr<GcRoot> *first, *last;
+         std::chrono::steady_clock::time_point deadline;
+         bool progressed;
+         std::atomic<std::size_t> next{ 0 };
+         static void run(void *p) noexcept {
+            auto &job = *static_cast<struct job*>(p);
+            for (;;) {
+               auto k = job.next++;
+               auto from = job.first + std::min<std::size_t>(k * PARALLEL_CHUNK, job.last - job.first);
+               if (from == job.last) return;
+               if ((k != 0 || job.progressed) && std::chrono::steady_clock::now() >= job.deadline) return;
+               finalize_runs(from, from + std::min<std::size_t>(PARALLEL_CHUNK, job.last - from));
+            }
          }
-
+      } j{ first, last, deadline, progressed };
+      // a finalizer that collects, run by the pool, finalizes on its own
+      if (static_cast<std::size_t>(last - first) <= PARALLEL_CHUNK || finalizer_pool::busy())
+         job::run(&j); // not worth waking the pool up, or not possible
+      else
+         finalizer_pool::get().run(job::run, &j);
+   }
+   // O(1): no need to look for the root
+   void make_collectable(GcRoot *p) {
+      std::lock_guard _ { m };
+      // a thread-confined object released by another thread ends up in
+      // that thread's GC, which knows nothing of it; there is no way to
+      // hand it back to its own (unlocked) GC, hence:
+      if (p->owner != this)
+         std::terminate();
+      p->next = nullptr;
+      *std::exchange(collectable_end, &p->next) = p;
+      ++nb_collectable;
+   }
+   // finalizes what was left pending, then collectable roots, within
+   // budget; what remains waits for the next collection. Nodes whose type
+   // allows it are finalized last, on the finalizer pool. Each root is
+   // swapped with the last root, then moved out. The nodes are only
+   // destroyed once roots is consistent again, as their destructors
+   // may release counting_ptrs or call gcnew (hence lock the GC)
+   void collect(collect_budget budget = {}) {
+      using namespace std::chrono;
+      budget.max_objects = std::max<std::size_t>(budget.max_objects, 1);
+      auto deadline = budget.max_time == nanoseconds::max() ?
+         steady_clock::time_point::max() : steady_clock::now() + budget.max_time;
+      std::unique_lock lck{ m };
+      auto dead = std::exchange(pending, {});
+      if (std::size(dead) < budget.max_objects) {
+         auto n = std::min(nb_collectable, budget.max_objects - std::size(dead));
+         dead.reserve(std::size(dead) + n);
+         for (; n != 0; --n, --nb_collectable) {
+            auto p = std::exchange(collectable, collectable->next);
+            auto i = p->index;
+            std::swap(roots[i], roots.back());
+            roots[i]->index = i;
+            dead.push_back(std::move(roots.back()));
+            roots.pop_back();
+         }
+         if (!collectable)
+            collectable_end = &collectable;
+      }
+      lck.unlock();
+      auto first = std::data(dead);
+      auto last = first + std::min(std::size(dead), budget.max_objects);
+      // the others keep their relative order
+      auto parallel = std::stable_partition(first, last, [](auto &p) { return !p->parallel; });
+      std::size_t i = 0;
+      for (std::size_t n = parallel - first; i != n; ) {
+         if (i != 0 && steady_clock::now() >= deadline) break;
+         auto f = dead[i]->finalize;
+         auto j = i + 1;
+         while (j != n && j - i != FINALIZE_BATCH && dead[j]->finalize == f)
+            ++j;
+         f(first + i, first + j);
+         i = j;
       }
+      if (first + i == parallel && parallel != last)
+         finalize_in_parallel(parallel, last, deadline, i != 0);
+      // finalized nodes left null pointers behind
+      lck.lock();
+      for (auto &p : dead)
+         if (p) pending.push_back(std::move(p));
    }
    template <class T, class ... Args>
       auto add_root(Args &&... args) {
-         auto q = static_cast<T*>(roots.emplace_back(
-            std::make_unique<GcNode<T>>(std::forward<Args>(args)...), false
-         ).first->get());
-         return counting_ptr{
-            q, [&,q]() {
-               for (auto &[p, coll] : roots)
-                  if (static_cast<void*>(q) == p.get()->get()) {
-                     coll = true;
-                     return;
-                  }
-            }
-         };
+         // T's constructor may call gcnew, hence built before locking
+         auto node = std::make_unique<GcNode<T>>(this, 0, std::forward<Args>(args)...);
+         auto q = node->get();
+         control_block<Policy> *ctl = node.get();
+         std::lock_guard _ { m };
+         node->index = std::size(roots);
+         roots.push_back(std::move(node));
+         return counting_ptr<T, Policy>{ q, ctl };
       }
-   template <class T, class ... Args>
-      friend counting_ptr<T> gcnew(Args&&...);
-   friend struct scoped_collect;
+   template <class T, class P, class ... Args>
+      friend counting_ptr<T, P> gcnew(Args&&...);
+   friend struct basic_scoped_collect<Policy>;
 public:
-   GC(const GC &) = delete;
-   GC& operator=(const GC &) = delete;
-};
-
-struct scoped_collect {
-   scoped_collect() = default;
-   scoped_collect(const scoped_collect &) = delete;
-   scoped_collect(scoped_collect &&) = delete;
-   scoped_collect& operator=(const scoped_collect &) = delete;
-   scoped_collect &operator=(scoped_collect &&) = delete;
-   ~scoped_collect() {
-      GC::get().collect();
+   basic_GC(const basic_GC &) = delete;
+   basic_GC& operator=(const basic_GC &) = delete;
+   // how many roots are waiting to be finalized
+   static std::size_t backlog() noexcept {
+      auto &gc = get();
+      std::lock_guard _ { gc.m };
+      return std::size(gc.pending) + gc.nb_collectable;
    }
 };
 
+template <class Policy>
+   struct basic_scoped_collect {
+      collect_budget budget;
+      explicit basic_scoped_collect(collect_budget budget = {}) noexcept : budget{ budget } {
+      }
+      basic_scoped_collect(const basic_scoped_collect &) = delete;
+      basic_scoped_collect(basic_scoped_collect &&) = delete;
+      basic_scoped_collect& operator=(const basic_scoped_collect &) = delete;
+      basic_scoped_collect &operator=(basic_scoped_collect &&) = delete;
+      ~basic_scoped_collect() {
+         basic_GC<Policy>::get().collect(budget);
+      }
+   };
+
+// the GC of the thread-confined objects (one per thread), the one used
+// unless asked otherwise
+using GC = basic_GC<thread_confined>;
+using scoped_collect = basic_scoped_collect<thread_confined>;
 
-template <class T, class ... Args>
-   counting_ptr<T> gcnew(Args &&... args) {
-      return GC::get().add_root<T>(std::forward<Args>(args)...);
+template <class T, class Policy, class ... Args>
+   counting_ptr<T, Policy> gcnew(Args &&... args) {
+      return basic_GC<Policy>::get().template add_root<T>(std::forward<Args>(args)...);
    }
 
 struct NamedThing {
@@ -220,10 +495,125 @@ auto f() {
    std::cout << '\"' << p->name << '\"' << std::endl;
 }
 
+//
+// many small types, each with a destructor of its own, allocated in
+// random order, then finalized in release order
+//
+inline long long sink = 0;
+
+template <int N>
+   struct Piece {
+      std::vector<int> data = std::vector<int>(N % 5 + 1, N);
+      ~Piece() {
+         for (auto x : data)
+            sink += x ^ (N * 31);
+      }
+   };
+
+//
+// buffers that hold secrets are wiped out before being freed; this does
+// not depend on anything else, hence may be done in parallel, or not
+// (both on a thread_safe GC, for a fair comparison)
+//
+template <bool Parallel>
+   struct Secret {
+      std::vector<unsigned char> data = std::vector<unsigned char>(4'096, 0x5a);
+      ~Secret() {
+         // volatile, so that the compiler does not skip the writes
+         for (volatile auto &c : data)
+            c = 0;
+      }
+   };
+template <>
+   struct parallel_finalization<Secret<true>> : std::true_type {
+   };
+
+template <bool Parallel>
+   auto finalize_secrets(int n) {
+      std::chrono::steady_clock::time_point pre;
+      {
+         auto _ = basic_scoped_collect<thread_safe>{};
+         for (int i = 0; i != n; ++i)
+            gcnew<Secret<Parallel>, thread_safe>(); // collectable right away
+         pre = std::chrono::steady_clock::now();
+      }
+      return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - pre);
+   }
+
+//
+// copying a counting_ptr back and forth, with atomic counts or not
+//
+template <class Policy>
+   auto copy_counting_ptrs(int nb_rounds, int nb_copies) {
+      auto _ = basic_scoped_collect<Policy>{};
+      auto p = gcnew<int, Policy>(0);
+      std::vector<counting_ptr<int, Policy>> v;
+      v.reserve(nb_copies);
+      auto pre = std::chrono::steady_clock::now();
+      for (int i = 0; i != nb_rounds; ++i) {
+         for (int j = 0; j != nb_copies; ++j)
+            v.push_back(p);
+         v.clear();
+      }
+      return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - pre);
+   }
+
+template <int ... Ns>
+   void spawn_pieces(int n, std::integer_sequence<int, Ns...>) {
+      using spawner = void (*)();
+      static constexpr spawner spawners[] { [] { gcnew<Piece<Ns>>(); }... };
+      std::mt19937 prng;
+      std::uniform_int_distribution<std::size_t> d{ 0, sizeof...(Ns) - 1 };
+      for (int i = 0; i != n; ++i)
+         spawners[d(prng)](); // collectable right away
+   }
+
 int main() {
    using namespace std;
    cout << "Pre" << endl;
    f();
    cout << h()->m() << endl;
+   // a scope that releases many objects, but only finalizes some
+   // of them; later scopes finalize the rest, a bit at a time
+   {
+      auto _ = scoped_collect{ collect_budget{ .max_objects = 1'000 } };
+      vector<counting_ptr<string>> v;
+      for(int i = 0; i != 10'000; ++i)
+         v.push_back(gcnew<string>(100, '#'));
+   }
+   cout << GC::backlog() << " objects left to finalize" << endl;
+   int nb_scopes = 0;
+   for(; GC::backlog() != 0; ++nb_scopes) {
+      auto _ = scoped_collect{ collect_budget{ .max_time = chrono::microseconds{ 50 } } };
+   }
+   cout << "finalized by " << nb_scopes << " later scopes" << endl;
+   {
+      constexpr int NB_TYPES = 32;
+      constexpr int NB_PIECES = 500'000;
+      chrono::steady_clock::time_point pre;
+      {
+         auto _ = scoped_collect{};
+         spawn_pieces(NB_PIECES, make_integer_sequence<int, NB_TYPES>{});
+         pre = chrono::steady_clock::now();
+      }
+      auto dt = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - pre);
+      cout << "Finalized in release order: "
+           << NB_PIECES << " objects of " << NB_TYPES << " types in " << dt.count() << "us" << endl;
+   }
+   {
+      constexpr int NB_SECRETS = 100'000;
+      auto dt_serial = finalize_secrets<false>(NB_SECRETS);
+      auto dt_parallel = finalize_secrets<true>(NB_SECRETS);
+      cout << NB_SECRETS << " secrets wiped serially:     " << dt_serial.count() << "us" << endl;
+      cout << NB_SECRETS << " secrets wiped on " << finalizer_pool::get().size() << " thread(s): " << dt_parallel.count() << "us" << endl;
+   }
+   {
+      constexpr int NB_ROUNDS = 1'000;
+      constexpr int NB_COPIES = 10'000;
+      auto dt_confined = copy_counting_ptrs<thread_confined>(NB_ROUNDS, NB_COPIES);
+      auto dt_safe = copy_counting_ptrs<thread_safe>(NB_ROUNDS, NB_COPIES);
+      cout << NB_ROUNDS * NB_COPIES << " copies, plain counts:  " << dt_confined.count() << "us" << endl;
+      cout << NB_ROUNDS * NB_COPIES << " copies, atomic counts: " << dt_safe.count() << "us" << endl;
+   }
    cout << "Post" << endl;
 }
@@ -5,29 +5,41 @@
 #include <string>
 #include <iostream>
 #include <atomic>
-#include <functional>
 #include <utility>
+#include <limits>
+#include <iterator>
 #include <mutex>
+#include <thread>
+#include <chrono>
+#include <algorithm>
 
 //
 // use-case : destroy all GcNodes when collecting, calling the proper dtors
 //
 // using counting_ptr to know which objects to collect
 //
+
+//
+// the object a counting_ptr points to lives in a control block, along
+// with its count (one allocation, one cache line touched when copying
+// a counting_ptr); the block is told through mark(), which does not
+// allocate, when the count reaches zero
+//
+struct control_block {
+   using count_type = std::atomic<int>;
+   count_type count{ 1 };
+   virtual void mark() noexcept = 0;
+   virtual ~control_block() = default;
+};
+
 template <class T>
    class counting_ptr {
-      using count_type = std::atomic<int>;
       T *p;
-      count_type *count;
-      std::function<void()> mark;
+      control_block *ctl;
    public:
-      template <class M>
-         constexpr counting_ptr(T *p, M mark) try : p{ p }, mark{ mark } {
-            count = new count_type{ 1 };
-         } catch(...) {
-            delete p;
-            throw;
-         }
+      // ctl's count already accounts for this counting_ptr
+      constexpr counting_ptr(T *p, control_block *ctl) noexcept : p{ p }, ctl{ ctl } {
+      }
       T& operator*() noexcept {
          return *p;
       }
@@ -65,36 +77,30 @@ template <class T>
       void swap(counting_ptr &other) {
          using std::swap;
          swap(p, other.p);
-         swap(count, other.count);
-         swap(mark, other.mark);
+         swap(ctl, other.ctl);
       }
       constexpr operator bool() const noexcept {
          return p != nullptr;
       }
       counting_ptr(counting_ptr &&other) noexcept
          : p{ std::exchange(other.p, nullptr) },
-           count{ std::exchange(other.count, nullptr) },
-           mark{ other.mark } {
+           ctl{ std::exchange(other.ctl, nullptr) } {
       }
       counting_ptr &operator=(counting_ptr &&other) noexcept {
          counting_ptr{ std::move(other) }.swap(*this);
          return *this;
       }
       counting_ptr(const counting_ptr &other)
-         : p{ other.p }, count{ other.count }, mark{ other.mark } {
-         if (count) ++(*count);
+         : p{ other.p }, ctl{ other.ctl } {
+         if (ctl) ++ctl->count;
       }
       counting_ptr &operator=(const counting_ptr &other) {
          counting_ptr{ other }.swap(*this);
          return *this;
       }
       ~counting_ptr() {
-         if (count) {
-            if ((*count)-- == 1) {
-               mark();
-               delete count;
-            }
-         }
+         if (ctl && ctl->count-- == 1)
+            ctl->mark();
       }
    };
 namespace std {
@@ -104,71 +110,182 @@ namespace std {
       }
 }
 
+//
+// how much a collection may finalize: at most max_objects roots, in
+// (about) max_time; at least one root is finalized if there is any,
+// so that collection always progresses, even with a zero budget. The
+// default is no limit
+//
+struct collect_budget {
+   std::size_t max_objects = std::numeric_limits<std::size_t>::max();
+   std::chrono::nanoseconds max_time = std::chrono::nanoseconds::max();
+};
+
 class GC {
+   class GcRoot;
+   // destroys the nodes in [first, last), all of the same type, and
+   // leaves null pointers behind; doubles as an identifier for that type
+   using finalizer = void (*)(std::unique_ptr<GcRoot>*, std::unique_ptr<GcRoot>*) noexcept;
+   // the longest run of same-typed nodes finalized in one call; the
+   // time budget of a collection is checked between two such runs
+   static constexpr std::size_t FINALIZE_BATCH = 64;
    std::mutex m;
-   class GcRoot {
-      void *p;
+   struct shard;
+   class GcRoot : public control_block {
    public:
-      auto get() const noexcept { return p; }
-      GcRoot(void *p) : p{ p } {
+      // the shard this root belongs to, and its position in there,
+      // kept up to date by collect()
+      shard *owner;
+      finalizer finalize;
+      std::size_t index = 0;
+      // next in the list of collectable roots
+      GcRoot *next = nullptr;
+      GcRoot(shard *owner, finalizer finalize) : owner{ owner }, finalize{ finalize } {
       }
       GcRoot(const GcRoot&) = delete;
       GcRoot& operator=(const GcRoot&) = delete;
-      virtual void destroy(void*) const noexcept = 0;
-      virtual ~GcRoot() = default;
+      void mark() noexcept override {
+         GC::get().make_collectable(this);
+      }
    };
-   template <class T> class GcNode : public GcRoot {
-      void destroy(void *q) const noexcept override {
-         delete static_cast<T*>(q);
+   // the object is stored in the node itself
+   template <class T> class GcNode final : public GcRoot {
+      T obj;
+      // GcNode being final, the destructor calls are not virtual
+      static void finalize_all(std::unique_ptr<GcRoot> *first, std::unique_ptr<GcRoot> *last) noexcept {
+         for (; first != last; ++first)
+            delete static_cast<GcNode*>(first->release());
       }
    public:
       template <class ... Args>
-         GcNode(Args &&... args) : GcRoot(new T(std::forward<Args>(args)...)) {
+         GcNode(shard *owner, Args &&... args)
+            : GcRoot{ owner, finalize_all }, obj(std::forward<Args>(args)...) {
          }
-      ~GcNode() {
-         destroy(get());
+      T *get() noexcept {
+         return &obj;
+      }
+   };
+   //
+   // roots are sharded: each thread appends to a shard of its own,
+   // whose mutex is only contended when collecting, or when another
+   // thread releases the last counting_ptr to one of its objects. A
+   // thread that ends hands its shard back, for another thread to
+   // reuse; collect() goes through all shards. m only protects the
+   // lists of shards, and is always locked before a shard's mutex
+   //
+   struct shard {
+      std::mutex m;
+      std::vector<std::unique_ptr<GcRoot>> roots;
+      // the roots whose counting_ptr count reached zero, in that order
+      // (intrusive list, appended to at its end)
+      GcRoot *collectable = nullptr;
+      GcRoot **collectable_end = &collectable;
+      std::size_t nb_collectable = 0;
+   };
+   std::vector<std::unique_ptr<shard>> shards;
+   std::vector<shard*> available;
+   // taken out of roots, but left to finalize by a budgeted collection
+   std::vector<std::unique_ptr<GcRoot>> pending;
+   class shard_lease {
+      shard *s;
+   public:
+      shard_lease() : s{ GC::get().acquire_shard() } {
+      }
+      shard_lease(const shard_lease&) = delete;
+      shard_lease& operator=(const shard_lease&) = delete;
+      ~shard_lease() {
+         GC::get().release_shard(s);
       }
+      shard &get() noexcept { return *s; }
    };
-   std::vector<std::pair<std::unique_ptr<GcRoot>, bool>> roots;
    GC() = default;
-   static auto &get() {
+   static GC &get() {
       static GC gc;
       return gc;
    }
-   void make_collectable(void *p) {
+   shard *acquire_shard() {
       std::lock_guard _ { m };
-      for (auto &[q, coll] : roots)
-         if (static_cast<GcRoot*>(p) == q.get())
-            coll = true;
+      if (!available.empty()) {
+         auto s = available.back();
+         available.pop_back();
+         return s;
+      }
+      return shards.emplace_back(std::make_unique<shard>()).get();
    }
-   void collect() {
+   void release_shard(shard *s) {
       std::lock_guard _ { m };
-      for (auto p = std::begin(roots); p != std::end(roots); ) {
-         if (auto &[ptr, collectible] = *p; collectible) {
-            ptr = nullptr;
-            p = roots.erase(p);
-         } else {
-            ++p;
+      available.push_back(s);
+   }
+   // this thread's shard
+   static shard &local_shard() {
+      thread_local shard_lease lease;
+      return lease.get();
+   }
+   // O(1): no need to look for the root
+   void make_collectable(GcRoot *p) {
+      std::lock_guard _ { p->owner->m };
+      p->next = nullptr;
+      *std::exchange(p->owner->collectable_end, &p->next) = p;
+      ++p->owner->nb_collectable;
+   }
+   // finalizes what was left pending, then collectable roots, within
+   // budget; what remains waits for the next collection. Each root is
+   // swapped with the last root of its shard, then moved out. The nodes
+   // are only destroyed once the mutexes are released: their destructors
+   // may release counting_ptrs or call gcnew, and other threads are not
+   // kept waiting for finalization
+   void collect(collect_budget budget = {}) {
+      using namespace std::chrono;
+      budget.max_objects = std::max<std::size_t>(budget.max_objects, 1);
+      auto deadline = budget.max_time == nanoseconds::max() ?
+         steady_clock::time_point::max() : steady_clock::now() + budget.max_time;
+      std::vector<std::unique_ptr<GcRoot>> dead;
+      {
+         std::lock_guard _ { m };
+         dead = std::exchange(pending, {});
+         for (auto &s : shards) {
+            if (std::size(dead) >= budget.max_objects) break;
+            std::lock_guard _ { s->m };
+            auto n = std::min(s->nb_collectable, budget.max_objects - std::size(dead));
+            dead.reserve(std::size(dead) + n);
+            for (auto &roots = s->roots; n != 0; --n, --s->nb_collectable) {
+               auto p = std::exchange(s->collectable, s->collectable->next);
+               auto i = p->index;
+               std::swap(roots[i], roots.back());
+               roots[i]->index = i;
+               dead.push_back(std::move(roots.back()));
+               roots.pop_back();
+            }
+            if (!s->collectable)
+               s->collectable_end = &s->collectable;
          }
-
       }
+      std::size_t i = 0;
+      for (auto n = std::min(std::size(dead), budget.max_objects); i != n; ) {
+         if (i != 0 && steady_clock::now() >= deadline) break;
+         auto f = dead[i]->finalize;
+         auto j = i + 1;
+         while (j != n && j - i != FINALIZE_BATCH && dead[j]->finalize == f)
+            ++j;
+         f(std::data(dead) + i, std::data(dead) + j);
+         i = j;
+      }
+      std::lock_guard _ { m };
+      pending.insert(std::end(pending),
+                     std::make_move_iterator(std::begin(dead) + i),
+                     std::make_move_iterator(std::end(dead)));
    }
    template <class T, class ... Args>
       auto add_root(Args &&... args) {
-         std::lock_guard _ { m };
-         auto q = static_cast<T*>(roots.emplace_back(
-            std::make_unique<GcNode<T>>(std::forward<Args>(args)...), false
-         ).first->get());
-         return counting_ptr{
-            q, [&,q]() {
-               std::lock_guard _ { m };
-               for (auto &[p, coll] : roots)
-                  if (static_cast<void*>(q) == p.get()->get()) {
-                     coll = true;
-                     return;
-                  }
-            }
-         };
+         auto &s = local_shard();
+         // the object's constructor might well call gcnew
+         auto node = std::make_unique<GcNode<T>>(&s, std::forward<Args>(args)...);
+         auto q = node->get();
+         auto ctl = node.get();
+         std::lock_guard _ { s.m };
+         node->index = std::size(s.roots);
+         s.roots.push_back(std::move(node));
+         return counting_ptr{ q, ctl };
       }
    template <class T, class ... Args>
       friend counting_ptr<T> gcnew(Args&&...);
@@ -176,16 +293,29 @@ class GC {
 public:
    GC(const GC &) = delete;
    GC& operator=(const GC &) = delete;
+   // how many roots are waiting to be finalized
+   static std::size_t backlog() {
+      auto &gc = get();
+      std::lock_guard _ { gc.m };
+      auto n = std::size(gc.pending);
+      for (auto &s : gc.shards) {
+         std::lock_guard _ { s->m };
+         n += s->nb_collectable;
+      }
+      return n;
+   }
 };
 
 struct scoped_collect {
-   scoped_collect() = default;
+   collect_budget budget;
+   explicit scoped_collect(collect_budget budget = {}) noexcept : budget{ budget } {
+   }
    scoped_collect(const scoped_collect &) = delete;
    scoped_collect(scoped_collect &&) = delete;
    scoped_collect& operator=(const scoped_collect &) = delete;
    scoped_collect &operator=(scoped_collect &&) = delete;
    ~scoped_collect() {
-      GC::get().collect();
+      GC::get().collect(budget);
    }
 };
 
@@ -225,10 +355,45 @@ auto f() {
    std::cout << '\"' << p->name << '\"' << std::endl;
 }
 
+// each thread allocates in its own shard
+auto allocate_in_parallel(unsigned nb_threads, int nb_per_thread) {
+   using namespace std::chrono;
+   auto pre = steady_clock::now();
+   {
+      std::vector<std::jthread> th;
+      for (unsigned i = 0; i != nb_threads; ++i)
+         th.emplace_back([nb_per_thread] {
+            auto _ = scoped_collect{};
+            for (int j = 0; j != nb_per_thread; ++j)
+               gcnew<int>(j);
+         });
+   }
+   return duration_cast<microseconds>(steady_clock::now() - pre);
+}
+
 int main() {
    using namespace std;
    cout << "Pre" << endl;
    f();
    cout << h()->m() << endl;
+   // a scope that releases many objects, but only finalizes some
+   // of them; later scopes finalize the rest, a bit at a time
+   {
+      auto _ = scoped_collect{ collect_budget{ .max_objects = 1'000 } };
+      vector<counting_ptr<string>> v;
+      for(int i = 0; i != 10'000; ++i)
+         v.push_back(gcnew<string>(100, '#'));
+   }
+   cout << GC::backlog() << " objects left to finalize" << endl;
+   int nb_scopes = 0;
+   for(; GC::backlog() != 0; ++nb_scopes) {
+      auto _ = scoped_collect{ collect_budget{ .max_time = chrono::microseconds{ 50 } } };
+   }
+   cout << "finalized by " << nb_scopes << " later scopes" << endl;
+   constexpr int NB_PER_THREAD = 100'000;
+   auto nb_threads = max(thread::hardware_concurrency(), 1u);
+   auto dt = allocate_in_parallel(nb_threads, NB_PER_THREAD);
+   cout << nb_threads << " threads, " << NB_PER_THREAD << " objects each, in "
+        << dt.count() << "us" << endl;
    cout << "Post" << endl;
 }
@@ -5,12 +5,46 @@
 #include <string>
 #include <print>
 #include <type_traits>
+#include <cstddef>
+#include <algorithm>
+#include <chrono>
 
 //
 // use-case : destroy all GcNodes when GC object is destroyed, no finalization (restricted to trivially destructible types)
 //
 class GC {
-   std::vector<void*> roots;
+   //
+   // objects are bump-allocated from regions of (at least) REGION_SIZE
+   // bytes; as there is no finalization, releasing all objects means
+   // releasing the regions, in O(regions) rather than O(objects)
+   //
+   class arena {
+      static constexpr std::size_t REGION_SIZE = 1024 * 1024;
+      std::vector<std::unique_ptr<char[]>> regions;
+      char *cur = nullptr, *end = nullptr;
+      std::size_t n = 0;
+   public:
+      void *allocate(std::size_t size, std::size_t align) {
+         void *p = cur;
+         std::size_t space = end - cur;
+         if (!std::align(align, size, p, space)) {
+            auto len = std::max(REGION_SIZE, size);
+            p = cur = regions.emplace_back(std::make_unique_for_overwrite<char[]>(len)).get();
+            end = cur + len;
+         }
+         cur = static_cast<char*>(p) + size;
+         ++n;
+         return p;
+      }
+      std::size_t size() const noexcept { return n; }
+      std::size_t nb_regions() const noexcept { return std::size(regions); }
+      void release() noexcept {
+         regions.clear();
+         cur = end = nullptr;
+         n = 0;
+      }
+   };
+   arena roots;
    GC() = default;
    static auto &get() {
       static GC gc;
@@ -20,18 +54,18 @@ class GC {
       T *add_root(Args &&... args) {
          // there will be no finalization
          static_assert(std::is_trivially_destructible_v<T>);
-         return static_cast<T*>(
-            roots.emplace_back(
-               new T(std::forward<Args>(args)...)
-            )
-         );
+         static_assert(alignof(T) <= alignof(std::max_align_t));
+         return new (roots.allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
       }
    template <class T, class ... Args>
       friend T* gcnew(Args&&...);
 public:
    ~GC() {
-      std::print("~GC with {} objects to deallocate", std::size(roots));
-      for(auto p : roots) std::free(p);
+      std::print("~GC with {} objects to deallocate ({} regions)", roots.size(), roots.nb_regions());
+   }
+   // deallocates all objects at once; there must be no use of them afterwards
+   static void collect_all() noexcept {
+      get().roots.release();
    }
    GC(const GC &) = delete;
    GC& operator=(const GC &) = delete;
@@ -83,7 +117,14 @@ auto f() {
 }
 
 int main() {
+   using namespace std::chrono;
    std::print("Pre\n");
    std::print("{}\n", f()->m());
+   constexpr int NB_OBJECTS = 1'000'000;
+   auto pre = steady_clock::now();
+   for(int i = 0; i != NB_OBJECTS; ++i)
+      gcnew<Identifier>(i);
+   auto post = steady_clock::now();
+   std::print("{} objects in {}\n", NB_OBJECTS, duration_cast<microseconds>(post - pre));
    std::print("Post\n");
 }
@@ -5,37 +5,120 @@
 #include <string>
 #include <print>
 #include <type_traits>
+#include <cstddef>
 #include <mutex>
+#include <thread>
+#include <chrono>
+#include <algorithm>
 
 //
 // use-case : destroy all GcNodes when GC object is destroyed, no finalization (restricted to trivially destructible types)
 //
 class GC {
    std::mutex m;
-   std::vector<void*> roots;
+   //
+   // objects are bump-allocated from regions of (at least) REGION_SIZE
+   // bytes; as there is no finalization, releasing all objects means
+   // releasing the regions, in O(regions) rather than O(objects)
+   //
+   class arena {
+      static constexpr std::size_t REGION_SIZE = 1024 * 1024;
+      std::vector<std::unique_ptr<char[]>> regions;
+      char *cur = nullptr, *end = nullptr;
+      std::size_t n = 0;
+   public:
+      void *allocate(std::size_t size, std::size_t align) {
+         void *p = cur;
+         std::size_t space = end - cur;
+         if (!std::align(align, size, p, space)) {
+            auto len = std::max(REGION_SIZE, size);
+            p = cur = regions.emplace_back(std::make_unique_for_overwrite<char[]>(len)).get();
+            end = cur + len;
+         }
+         cur = static_cast<char*>(p) + size;
+         ++n;
+         return p;
+      }
+      std::size_t size() const noexcept { return n; }
+      std::size_t nb_regions() const noexcept { return std::size(regions); }
+      void release() noexcept {
+         regions.clear();
+         cur = end = nullptr;
+         n = 0;
+      }
+   };
+   //
+   // roots are sharded: each thread appends to a shard of its own,
+   // without locking. A thread that ends hands its shard back, for
+   // another thread to reuse; the roots in there stay alive until
+   // the GC is destroyed. m only protects the lists of shards
+   //
+   struct shard {
+      arena roots;
+   };
+   std::vector<std::unique_ptr<shard>> shards;
+   std::vector<shard*> available;
+   class shard_lease {
+      shard *s;
+   public:
+      shard_lease() : s{ GC::get().acquire_shard() } {
+      }
+      shard_lease(const shard_lease&) = delete;
+      shard_lease& operator=(const shard_lease&) = delete;
+      ~shard_lease() {
+         GC::get().release_shard(s);
+      }
+      shard &get() noexcept { return *s; }
+   };
    GC() = default;
-   static auto &get() {
+   static GC &get() {
       static GC gc;
       return gc;
    }
+   shard *acquire_shard() {
+      std::lock_guard _ { m };
+      if (!available.empty()) {
+         auto s = available.back();
+         available.pop_back();
+         return s;
+      }
+      return shards.emplace_back(std::make_unique<shard>()).get();
+   }
+   void release_shard(shard *s) {
+      std::lock_guard _ { m };
+      available.push_back(s);
+   }
+   // this thread's shard
+   static shard &local_shard() {
+      thread_local shard_lease lease;
+      return lease.get();
+   }
    template <class T, class ... Args>
       T *add_root(Args &&... args) {
-         std::lock_guard _ { m };
          // there will be no finalization
          static_assert(std::is_trivially_destructible_v<T>);
-         return static_cast<T*>(
-            roots.emplace_back(
-               new T(std::forward<Args>(args)...)
-            )
-         );
+         static_assert(alignof(T) <= alignof(std::max_align_t));
+         return new (local_shard().roots.allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
       }
    template <class T, class ... Args>
       friend T* gcnew(Args&&...);
 public:
    ~GC() {
-      std::print("~GC with {} objects to deallocate", std::size(roots));
       std::lock_guard _ { m }; // redundant, but on principle...
-      for(auto p : roots) std::free(p);
+      std::size_t n = 0, nregions = 0;
+      for(auto &s : shards) {
+         n += s->roots.size();
+         nregions += s->roots.nb_regions();
+      }
+      std::print("~GC with {} objects to deallocate ({} regions)", n, nregions);
+   }
+   // deallocates all objects at once; there must be no use of them
+   // afterwards, and no thread may be calling gcnew in the meantime
+   static void collect_all() noexcept {
+      auto &gc = get();
+      std::lock_guard _ { gc.m };
+      for(auto &s : gc.shards)
+         s->roots.release();
    }
    GC(const GC &) = delete;
    GC& operator=(const GC &) = delete;
@@ -86,8 +169,27 @@ auto f() {
    return h();
 }
 
+// each thread allocates in its own shard
+auto allocate_in_parallel(unsigned nb_threads, int nb_per_thread) {
+   using namespace std::chrono;
+   auto pre = steady_clock::now();
+   {
+      std::vector<std::jthread> th;
+      for (unsigned i = 0; i != nb_threads; ++i)
+         th.emplace_back([nb_per_thread] {
+            for (int j = 0; j != nb_per_thread; ++j)
+               gcnew<Identifier>(j);
+         });
+   }
+   return duration_cast<microseconds>(steady_clock::now() - pre);
+}
+
 int main() {
    std::print("Pre\n");
    std::print("{}\n", f()->m());
+   constexpr int NB_PER_THREAD = 100'000;
+   auto nb_threads = std::max(std::thread::hardware_concurrency(), 1u);
+   auto dt = allocate_in_parallel(nb_threads, NB_PER_THREAD);
+   std::print("{} threads, {} objects each, in {}\n", nb_threads, NB_PER_THREAD, dt);
    std::print("Post\n");
 }
@@ -0,0 +1,374 @@
+#include <vector>
+#include <memory>
+#include <string>
+#include <atomic>
+#include <utility>
+#include <mutex>
+#include <condition_variable>
+#include <stop_token>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <print>
+
+//
+// use-case : destroy all GcNodes when collecting, calling the proper dtors
+//
+// using counting_ptr to know which objects to collect, and optionally
+// a background collector thread so that the cost of finalization does
+// not land on the threads that release objects
+//
+
+//
+// the object a counting_ptr points to lives in a control block, along
+// with its count (one allocation, one cache line touched when copying
+// a counting_ptr); the block is told through mark(), which does not
+// allocate, when the count reaches zero
+//
+struct control_block {
+   using count_type = std::atomic<int>;
+   count_type count{ 1 };
+   virtual void mark() noexcept = 0;
+   virtual ~control_block() = default;
+};
+
+template <class T>
+   class counting_ptr {
+      T *p;
+      control_block *ctl;
+   public:
+      // ctl's count already accounts for this counting_ptr
+      constexpr counting_ptr(T *p, control_block *ctl) noexcept : p{ p }, ctl{ ctl } {
+      }
+      T& operator*() noexcept {
+         return *p;
+      }
+      const T& operator*() const noexcept {
+         return *p;
+      }
+      T* operator->() noexcept {
+         return p;
+      }
+      const T* operator->() const noexcept {
+         return p;
+      }
+      constexpr bool operator==(const counting_ptr &other) const {
+         return p == other.p;
+      }
+      constexpr bool operator!=(const counting_ptr &other) const {
+         return !(*this == other);
+      }
+      template <class U>
+         constexpr bool operator==(const counting_ptr<U> &other) const {
+            return p == &*other;
+         }
+      template <class U>
+         constexpr bool operator!=(const counting_ptr<U> &other) const {
+            return !(*this == other);
+         }
+      template <class U>
+         constexpr bool operator==(const U *q) const {
+            return p == q;
+         }
+      template <class U>
+         constexpr bool operator!=(const U *q) const {
+            return !(*this == q);
+         }
+      void swap(counting_ptr &other) {
+         using std::swap;
+         swap(p, other.p);
+         swap(ctl, other.ctl);
+      }
+      constexpr operator bool() const noexcept {
+         return p != nullptr;
+      }
+      counting_ptr(counting_ptr &&other) noexcept
+         : p{ std::exchange(other.p, nullptr) },
+           ctl{ std::exchange(other.ctl, nullptr) } {
+      }
+      counting_ptr &operator=(counting_ptr &&other) noexcept {
+         counting_ptr{ std::move(other) }.swap(*this);
+         return *this;
+      }
+      counting_ptr(const counting_ptr &other)
+         : p{ other.p }, ctl{ other.ctl } {
+         if (ctl) ++ctl->count;
+      }
+      counting_ptr &operator=(const counting_ptr &other) {
+         counting_ptr{ other }.swap(*this);
+         return *this;
+      }
+      ~counting_ptr() {
+         if (ctl && ctl->count-- == 1)
+            ctl->mark();
+      }
+   };
+namespace std {
+   template <class T, class M>
+      void swap(counting_ptr<T> &a, counting_ptr<T> &b) {
+         a.swap(b);
+      }
+}
+
+class GC {
+   std::mutex m;
+   class GcRoot : public control_block {
+   public:
+      // position of this root in roots, kept up to date by take()
+      std::size_t index;
+      // next in the list of collectable roots
+      GcRoot *next = nullptr;
+      GcRoot(std::size_t index) : index{ index } {
+      }
+      GcRoot(const GcRoot&) = delete;
+      GcRoot& operator=(const GcRoot&) = delete;
+      void mark() noexcept override {
+         GC::get().make_collectable(this);
+      }
+   };
+   // the object is stored in the node itself
+   template <class T> class GcNode : public GcRoot {
+      T obj;
+   public:
+      template <class ... Args>
+         GcNode(std::size_t index, Args &&... args)
+            : GcRoot{ index }, obj(std::forward<Args>(args)...) {
+         }
+      T *get() noexcept {
+         return &obj;
+      }
+   };
+   std::vector<std::unique_ptr<GcRoot>> roots;
+   // the roots whose counting_ptr count reached zero, in that order
+   // (intrusive list, appended to at its end)
+   GcRoot *collectable = nullptr;
+   GcRoot **collectable_end = &collectable;
+   std::size_t nb_collectable = 0;
+   //
+   // background collection: the collector thread wakes up every
+   // interval, or as soon as batch roots are collectable, and
+   // finalizes them batch by batch, releasing m in between
+   //
+   std::condition_variable_any wakeup, idle;
+   std::size_t batch = 256;
+   std::chrono::milliseconds interval{ 10 };
+   std::size_t in_flight = 0; // taken by the collector, not yet destroyed
+   bool urgent = false;       // a flush() is waiting
+   std::jthread collector;    // last, so that it stops first
+   GC() = default;
+   static GC &get() {
+      static GC gc;
+      return gc;
+   }
+   // O(1): no need to look for the root
+   void make_collectable(GcRoot *p) {
+      std::lock_guard _ { m };
+      p->next = nullptr;
+      *std::exchange(collectable_end, &p->next) = p;
+      ++nb_collectable;
+   }
+   // precondition: m is locked. Takes (at most) n collectable roots
+   // out of roots; each one is swapped with the last root, then
+   // moved out. The caller destroys them once m is released
+   std::vector<std::unique_ptr<GcRoot>> take(std::size_t n) {
+      std::vector<std::unique_ptr<GcRoot>> dead;
+      dead.reserve(std::min(n, nb_collectable));
+      for (; collectable && std::size(dead) != n; --nb_collectable) {
+         auto p = std::exchange(collectable, collectable->next);
+         auto i = p->index;
+         std::swap(roots[i], roots.back());
+         roots[i]->index = i;
+         dead.push_back(std::move(roots.back()));
+         roots.pop_back();
+      }
+      if (!collectable)
+         collectable_end = &collectable;
+      return dead;
+   }
+   bool quiescent() const noexcept {
+      return !collectable && !in_flight;
+   }
+   // in background mode, only wakes up the collector if there is
+   // enough work for a batch; otherwise, finalizes on this thread
+   void collect() {
+      if (collector.joinable()) {
+         std::lock_guard _ { m };
+         if (nb_collectable >= batch)
+            wakeup.notify_one();
+         return;
+      }
+      std::vector<std::unique_ptr<GcRoot>> dead;
+      {
+         std::lock_guard _ { m };
+         dead = take(nb_collectable);
+      }
+      // dead nodes are destroyed here
+   }
+   void collector_loop(std::stop_token st) {
+      std::unique_lock lck{ m };
+      for (;;) {
+         wakeup.wait_for(lck, st, interval, [this] {
+            return urgent || nb_collectable >= batch;
+         });
+         // finalizers may make other roots collectable
+         while (collectable) {
+            auto dead = take(batch);
+            in_flight = std::size(dead);
+            lck.unlock();
+            dead.clear();
+            lck.lock();
+            in_flight = 0;
+         }
+         urgent = false;
+         idle.notify_all();
+         if (st.stop_requested()) return;
+      }
+   }
+   template <class T, class ... Args>
+      auto add_root(Args &&... args) {
+         // the object's constructor might well call gcnew
+         auto node = std::make_unique<GcNode<T>>(0, std::forward<Args>(args)...);
+         auto q = node->get();
+         auto ctl = node.get();
+         std::lock_guard _ { m };
+         node->index = std::size(roots);
+         roots.push_back(std::move(node));
+         return counting_ptr{ q, ctl };
+      }
+   template <class T, class ... Args>
+      friend counting_ptr<T> gcnew(Args&&...);
+   friend struct scoped_collect;
+public:
+   GC(const GC &) = delete;
+   GC& operator=(const GC &) = delete;
+   //
+   // knobs; meant to be set up front (e.g. at startup), from one thread
+   //
+   // starts (or stops, after it has finished its work) the collector thread
+   static void background(bool on) {
+      auto &gc = get();
+      if (on == gc.collector.joinable()) return;
+      if (on)
+         gc.collector = std::jthread{ [&gc](std::stop_token st) { gc.collector_loop(st); } };
+      else
+         gc.collector = std::jthread{}; // requests stop, then joins
+   }
+   // how many roots the collector finalizes between two locks of m
+   static void batch_size(std::size_t n) {
+      auto &gc = get();
+      std::lock_guard _ { gc.m };
+      gc.batch = std::max<std::size_t>(n, 1);
+   }
+   // how long the collector sleeps when there is not a batch's worth of work
+   static void wakeup_interval(std::chrono::milliseconds dt) {
+      auto &gc = get();
+      std::lock_guard _ { gc.m };
+      gc.interval = dt;
+   }
+   // returns once every collectable root (including those made
+   // collectable by finalizers in the meantime) has been finalized
+   static void flush() {
+      auto &gc = get();
+      if (!gc.collector.joinable()) {
+         for (;;) {
+            std::vector<std::unique_ptr<GcRoot>> dead;
+            {
+               std::lock_guard _ { gc.m };
+               if (!gc.collectable) return;
+               dead = gc.take(gc.nb_collectable);
+            }
+         }
+      }
+      std::unique_lock lck{ gc.m };
+      gc.urgent = true;
+      gc.wakeup.notify_one();
+      gc.idle.wait(lck, [&gc] { return gc.quiescent(); });
+   }
+};
+
+struct scoped_collect {
+   scoped_collect() = default;
+   scoped_collect(const scoped_collect &) = delete;
+   scoped_collect(scoped_collect &&) = delete;
+   scoped_collect& operator=(const scoped_collect &) = delete;
+   scoped_collect &operator=(scoped_collect &&) = delete;
+   ~scoped_collect() {
+      GC::get().collect();
+   }
+};
+
+
+template <class T, class ... Args>
+   counting_ptr<T> gcnew(Args &&... args) {
+      return GC::get().add_root<T>(std::forward<Args>(args)...);
+   }
+
+struct NamedThing {
+   const char *name;
+   NamedThing(const char *name) : name{ name } {
+      std::print("{} ctor\n", name);
+   }
+   ~NamedThing() {
+      std::print("{} dtor\n", name);
+   }
+};
+
+auto g() {
+   auto _ = scoped_collect{};
+   [[maybe_unused]] auto p = gcnew<NamedThing>("hi");
+   auto q = gcnew<NamedThing>("there");
+   return q;
+}
+
+auto f() {
+   auto _ = scoped_collect{};
+   auto p = g();
+   std::print("\"{}\"\n", p->name);
+}
+
+// something with a finalizer that costs a bit
+struct Payload {
+   std::vector<std::string> lines;
+   Payload() : lines(16, std::string(64, '#')) {
+   }
+};
+
+// NB_REQUESTS requests, each releasing NB_PER_REQUEST objects;
+// returns the worst latency seen by a request
+auto worst_request(int nb_requests, int nb_per_request) {
+   using namespace std::chrono;
+   nanoseconds worst{};
+   for (int r = 0; r != nb_requests; ++r) {
+      auto pre = steady_clock::now();
+      {
+         auto _ = scoped_collect{};
+         std::vector<counting_ptr<Payload>> v;
+         for (int i = 0; i != nb_per_request; ++i)
+            v.push_back(gcnew<Payload>());
+      }
+      worst = std::max<nanoseconds>(worst, steady_clock::now() - pre);
+   }
+   return duration_cast<microseconds>(worst);
+}
+
+int main() {
+   std::print("Pre\n");
+   f();
+   std::print("Post\n");
+   constexpr int NB_REQUESTS = 100;
+   constexpr int NB_PER_REQUEST = 1'000;
+   // (background collection only pays off with a core to spare)
+   auto sync = worst_request(NB_REQUESTS, NB_PER_REQUEST);
+   GC::background(true);
+   GC::batch_size(512);
+   GC::wakeup_interval(std::chrono::milliseconds{ 5 });
+   auto bg = worst_request(NB_REQUESTS, NB_PER_REQUEST);
+   GC::flush();
+   std::print("Worst request, collecting on the caller's thread: {}\n", sync);
+   std::print("Worst request, collecting in the background:      {}\n", bg);
+   {
+      [[maybe_unused]] auto p = gcnew<NamedThing>("late");
+   }
+   GC::background(false); // finalizes "late" before stopping
+   std::print("Done\n");
+}
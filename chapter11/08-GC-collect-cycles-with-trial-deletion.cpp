@@ -0,0 +1,568 @@
+#include <vector>
+#include <memory>
+#include <string>
+#include <iostream>
+#include <atomic>
+#include <utility>
+#include <chrono>
+#include <limits>
+#include <iterator>
+#include <algorithm>
+
+//
+// use-case : destroy all GcNodes when collecting, calling the proper dtors
+//
+// using counting_ptr to know which objects to collect, and trial deletion
+// (Bacon & Rajan's synchronous cycle collection) to find the cycles of
+// objects that counting alone would keep alive forever
+//
+
+//
+// the object a counting_ptr points to lives in a control block, along
+// with its count (one allocation, one cache line touched when copying
+// a counting_ptr); the block is told through mark(), which does not
+// allocate, when the count reaches zero. Objects that may be part of a
+// cycle are traceable (may_cycle), and their block is told through
+// possible_cycle() when their count goes down without reaching zero
+//
+struct control_block {
+   using count_type = std::atomic<int>;
+   count_type count{ 1 };
+   bool may_cycle = false;
+   virtual void mark() noexcept = 0;
+   virtual void possible_cycle() noexcept = 0;
+   virtual ~control_block() = default;
+};
+
+template <class T>
+   class counting_ptr {
+      T *p;
+      control_block *ctl;
+   public:
+      // ctl's count already accounts for this counting_ptr
+      constexpr counting_ptr(T *p, control_block *ctl) noexcept : p{ p }, ctl{ ctl } {
+      }
+      T& operator*() noexcept {
+         return *p;
+      }
+      const T& operator*() const noexcept {
+         return *p;
+      }
+      T* operator->() noexcept {
+         return p;
+      }
+      const T* operator->() const noexcept {
+         return p;
+      }
+      constexpr bool operator==(const counting_ptr &other) const {
+         return p == other.p;
+      }
+      constexpr bool operator!=(const counting_ptr &other) const {
+         return !(*this == other);
+      }
+      template <class U>
+         constexpr bool operator==(const counting_ptr<U> &other) const {
+            return p == &*other;
+         }
+      template <class U>
+         constexpr bool operator!=(const counting_ptr<U> &other) const {
+            return !(*this == other);
+         }
+      template <class U>
+         constexpr bool operator==(const U *q) const {
+            return p == q;
+         }
+      template <class U>
+         constexpr bool operator!=(const U *q) const {
+            return !(*this == q);
+         }
+      void swap(counting_ptr &other) {
+         using std::swap;
+         swap(p, other.p);
+         swap(ctl, other.ctl);
+      }
+      constexpr operator bool() const noexcept {
+         return p != nullptr;
+      }
+      counting_ptr(counting_ptr &&other) noexcept
+         : p{ std::exchange(other.p, nullptr) },
+           ctl{ std::exchange(other.ctl, nullptr) } {
+      }
+      counting_ptr &operator=(counting_ptr &&other) noexcept {
+         counting_ptr{ std::move(other) }.swap(*this);
+         return *this;
+      }
+      counting_ptr(const counting_ptr &other)
+         : p{ other.p }, ctl{ other.ctl } {
+         if (ctl) ++ctl->count;
+      }
+      counting_ptr &operator=(const counting_ptr &other) {
+         counting_ptr{ other }.swap(*this);
+         return *this;
+      }
+      ~counting_ptr() {
+         if (!ctl) return;
+         if (ctl->count-- == 1)
+            ctl->mark();
+         else if (ctl->may_cycle)
+            ctl->possible_cycle();
+      }
+      // for the cycle collector
+      control_block *control() const noexcept {
+         return ctl;
+      }
+   };
+namespace std {
+   template <class T, class M>
+      void swap(counting_ptr<T> &a, counting_ptr<T> &b) {
+         a.swap(b);
+      }
+}
+
+//
+// a type whose objects may hold counting_ptrs to other objects (hence be
+// part of a cycle) exposes them to the cycle collector through
+//
+//    template <class F> void trace(F f) { f(child0); f(child1); ... }
+//
+// objects of other types are leaves, and never considered as candidates
+//
+template <class T>
+   concept traceable = requires(T &obj) {
+      obj.trace([](auto &) {});
+   };
+
+//
+// how much a collection may finalize: at most max_objects roots, in
+// (about) max_time; at least one root is finalized if there is any,
+// so that collection always progresses, even with a zero budget. The
+// default is no limit
+//
+struct collect_budget {
+   std::size_t max_objects = std::numeric_limits<std::size_t>::max();
+   std::chrono::nanoseconds max_time = std::chrono::nanoseconds::max();
+};
+
+class GC {
+   class GcRoot;
+   // destroys the nodes in [first, last), all of the same type, and
+   // leaves null pointers behind; doubles as an identifier for that type
+   using finalizer = void (*)(std::unique_ptr<GcRoot>*, std::unique_ptr<GcRoot>*) noexcept;
+   // the longest run of same-typed nodes finalized in one call; the
+   // time budget of a collection is checked between two such runs
+   static constexpr std::size_t FINALIZE_BATCH = 64;
+   class GcRoot : public control_block {
+   public:
+      // position of this root in roots, kept up to date by collect()
+      std::size_t index;
+      finalizer finalize;
+      // next in the list of collectable roots
+      GcRoot *next = nullptr;
+      //
+      // cycle collection: black is in use (or assumed so), gray is being
+      // considered, white is garbage, purple is a candidate root. The
+      // candidates form an intrusive, doubly-linked list
+      //
+      enum class color : unsigned char { black, gray, white, purple };
+      color col = color::black;
+      bool buffered = false;
+      bool doomed = false; // part of a garbage cycle being reclaimed
+      GcRoot *prev_candidate = nullptr, *next_candidate = nullptr;
+      GcRoot(std::size_t index, finalizer finalize, bool may_cycle)
+         : index{ index }, finalize{ finalize } {
+         this->may_cycle = may_cycle;
+      }
+      GcRoot(const GcRoot&) = delete;
+      GcRoot& operator=(const GcRoot&) = delete;
+      void mark() noexcept override {
+         GC::get().make_collectable(this);
+      }
+      void possible_cycle() noexcept override {
+         GC::get().add_candidate(this);
+      }
+      // appends the roots this one holds counting_ptrs to
+      virtual void children(std::vector<GcRoot*> &) = 0;
+      // runs the object's destructor, but keeps the node around
+      virtual void destroy_object() noexcept = 0;
+   };
+   // the object is stored in the node itself
+   template <class T> class GcNode final : public GcRoot {
+      union { T obj; }; // destroyed by hand
+      bool alive = true;
+      // GcNode being final, the destructor calls are not virtual
+      static void finalize_all(std::unique_ptr<GcRoot> *first, std::unique_ptr<GcRoot> *last) noexcept {
+         for (; first != last; ++first)
+            delete static_cast<GcNode*>(first->release());
+      }
+   public:
+      template <class ... Args>
+         GcNode(std::size_t index, Args &&... args)
+            : GcRoot{ index, finalize_all, traceable<T> }, obj(std::forward<Args>(args)...) {
+         }
+      ~GcNode() {
+         destroy_object();
+      }
+      T *get() noexcept {
+         return &obj;
+      }
+      void children(std::vector<GcRoot*> &out) override {
+         if constexpr (traceable<T>)
+            obj.trace([&out](auto &p) {
+               if (auto ctl = p.control())
+                  out.push_back(static_cast<GcRoot*>(ctl));
+            });
+      }
+      void destroy_object() noexcept override {
+         if (alive) {
+            alive = false;
+            obj.~T();
+         }
+      }
+   };
+   std::vector<std::unique_ptr<GcRoot>> roots;
+   // the roots whose counting_ptr count reached zero, in that order
+   // (intrusive list, appended to at its end)
+   GcRoot *collectable = nullptr;
+   GcRoot **collectable_end = &collectable;
+   std::size_t nb_collectable = 0;
+   // taken out of roots, but left to finalize by a budgeted collection
+   std::vector<std::unique_ptr<GcRoot>> pending;
+   // candidate roots of garbage cycles
+   GcRoot *candidates = nullptr;
+   std::size_t nb_candidates = 0;
+   // cycles are looked for by collect() once there are that many candidates
+   std::size_t nb_candidates_max = 10'000;
+   GC() = default;
+   static GC &get() {
+      static GC gc;
+      return gc;
+   }
+   // O(1): no need to look for the root
+   void make_collectable(GcRoot *p) {
+      if (p->doomed) return; // reclaimed by collect_cycles()
+      if (p->buffered) remove_candidate(p);
+      p->next = nullptr;
+      *std::exchange(collectable_end, &p->next) = p;
+      ++nb_collectable;
+   }
+   void add_candidate(GcRoot *p) noexcept {
+      if (p->doomed) return;
+      p->col = GcRoot::color::purple;
+      if (p->buffered) return;
+      p->buffered = true;
+      p->prev_candidate = nullptr;
+      p->next_candidate = std::exchange(candidates, p);
+      if (p->next_candidate) p->next_candidate->prev_candidate = p;
+      ++nb_candidates;
+   }
+   void remove_candidate(GcRoot *p) noexcept {
+      p->buffered = false;
+      (p->prev_candidate ? p->prev_candidate->next_candidate : candidates) = p->next_candidate;
+      if (p->next_candidate) p->next_candidate->prev_candidate = p->prev_candidate;
+      --nb_candidates;
+   }
+   //
+   // trial deletion, starting from the candidates: the counts that come
+   // from within the subgraph reachable from them are removed (mark_gray);
+   // what still has a count is referenced from outside, as is everything
+   // it reaches, which gets its counts back (scan, scan_black); what
+   // remains (white) is garbage held by cycles only. Iterative, as the
+   // subgraphs may be deep
+   //
+   void mark_gray(GcRoot *s, std::vector<GcRoot*> &stack, std::vector<GcRoot*> &kids) {
+      using enum GcRoot::color;
+      if (s->col == gray) return;
+      s->col = gray;
+      stack.push_back(s);
+      while (!stack.empty()) {
+         auto p = stack.back();
+         stack.pop_back();
+         kids.clear();
+         p->children(kids);
+         for (auto c : kids) {
+            --c->count;
+            if (c->col != gray) {
+               c->col = gray;
+               stack.push_back(c);
+            }
+         }
+      }
+   }
+   void scan_black(GcRoot *s, std::vector<GcRoot*> &stack, std::vector<GcRoot*> &kids) {
+      using enum GcRoot::color;
+      s->col = black;
+      std::size_t base = std::size(stack);
+      stack.push_back(s);
+      while (std::size(stack) != base) {
+         auto p = stack.back();
+         stack.pop_back();
+         kids.clear();
+         p->children(kids);
+         for (auto c : kids) {
+            ++c->count;
+            if (c->col != black) {
+               c->col = black;
+               stack.push_back(c);
+            }
+         }
+      }
+   }
+   // scan_black works above what scan left on the stack
+   void scan(GcRoot *s, std::vector<GcRoot*> &stack, std::vector<GcRoot*> &kids) {
+      using enum GcRoot::color;
+      std::size_t base = std::size(stack);
+      stack.push_back(s);
+      while (std::size(stack) != base) {
+         auto p = stack.back();
+         stack.pop_back();
+         if (p->col != gray) continue;
+         if (p->count > 0) {
+            scan_black(p, stack, kids);
+         } else {
+            p->col = white;
+            kids.clear();
+            p->children(kids);
+            stack.insert(std::end(stack), std::begin(kids), std::end(kids));
+         }
+      }
+   }
+   void collect_white(GcRoot *s, std::vector<GcRoot*> &stack, std::vector<GcRoot*> &garbage,
+                      std::vector<GcRoot*> &kids) {
+      using enum GcRoot::color;
+      stack.push_back(s);
+      while (!stack.empty()) {
+         auto p = stack.back();
+         stack.pop_back();
+         if (p->col != white || p->buffered) continue;
+         p->col = black;
+         garbage.push_back(p);
+         kids.clear();
+         p->children(kids);
+         stack.insert(std::end(stack), std::begin(kids), std::end(kids));
+      }
+   }
+   void collect_cycles() {
+      using enum GcRoot::color;
+      std::vector<GcRoot*> starts, stack, kids, garbage;
+      starts.reserve(nb_candidates);
+      while (candidates) {
+         auto p = candidates;
+         remove_candidate(p);
+         if (p->col == purple)
+            starts.push_back(p);
+      }
+      for (auto p : starts)
+         mark_gray(p, stack, kids);
+      for (auto p : starts)
+         scan(p, stack, kids);
+      for (auto p : starts)
+         collect_white(p, stack, garbage, kids);
+      if (garbage.empty()) return;
+      //
+      // the counts mark_gray took away on behalf of the garbage are given
+      // back, as its destructors are about to release these counting_ptrs.
+      // They all run before any node is freed, as the garbage references
+      // itself; doomed nodes ignore these releases
+      //
+      for (auto p : garbage)
+         p->doomed = true;
+      std::vector<std::unique_ptr<GcRoot>> dead;
+      dead.reserve(std::size(garbage));
+      for (auto p : garbage) {
+         kids.clear();
+         p->children(kids);
+         for (auto c : kids)
+            ++c->count;
+         auto i = p->index;
+         std::swap(roots[i], roots.back());
+         roots[i]->index = i;
+         dead.push_back(std::move(roots.back()));
+         roots.pop_back();
+      }
+      for (auto &p : dead)
+         p->destroy_object();
+      // nodes are freed here
+   }
+   // finalizes what was left pending, then collectable roots, within
+   // budget; what remains waits for the next collection. If there are
+   // enough candidates, cycles are looked for first, which the budget
+   // does not bound. Each root is swapped with the last root, then
+   // moved out. The nodes are only destroyed once roots is consistent
+   // again, as their destructors may release counting_ptrs or call gcnew
+   void collect(collect_budget budget = {}) {
+      using namespace std::chrono;
+      budget.max_objects = std::max<std::size_t>(budget.max_objects, 1);
+      if (nb_candidates >= nb_candidates_max)
+         collect_cycles();
+      auto deadline = budget.max_time == nanoseconds::max() ?
+         steady_clock::time_point::max() : steady_clock::now() + budget.max_time;
+      auto dead = std::exchange(pending, {});
+      if (std::size(dead) < budget.max_objects) {
+         auto n = std::min(nb_collectable, budget.max_objects - std::size(dead));
+         dead.reserve(std::size(dead) + n);
+         for (; n != 0; --n, --nb_collectable) {
+            auto p = std::exchange(collectable, collectable->next);
+            auto i = p->index;
+            std::swap(roots[i], roots.back());
+            roots[i]->index = i;
+            dead.push_back(std::move(roots.back()));
+            roots.pop_back();
+         }
+         if (!collectable)
+            collectable_end = &collectable;
+      }
+      std::size_t i = 0;
+      for (auto n = std::min(std::size(dead), budget.max_objects); i != n; ) {
+         if (i != 0 && steady_clock::now() >= deadline) break;
+         auto f = dead[i]->finalize;
+         auto j = i + 1;
+         while (j != n && j - i != FINALIZE_BATCH && dead[j]->finalize == f)
+            ++j;
+         f(std::data(dead) + i, std::data(dead) + j);
+         i = j;
+      }
+      pending.insert(std::end(pending),
+                     std::make_move_iterator(std::begin(dead) + i),
+                     std::make_move_iterator(std::end(dead)));
+   }
+   template <class T, class ... Args>
+      auto add_root(Args &&... args) {
+         auto node = std::make_unique<GcNode<T>>(std::size(roots), std::forward<Args>(args)...);
+         auto q = node->get();
+         auto ctl = node.get();
+         roots.push_back(std::move(node));
+         return counting_ptr{ q, ctl };
+      }
+   template <class T, class ... Args>
+      friend counting_ptr<T> gcnew(Args&&...);
+   friend struct scoped_collect;
+public:
+   GC(const GC &) = delete;
+   GC& operator=(const GC &) = delete;
+   // how many roots are waiting to be finalized
+   static std::size_t backlog() noexcept {
+      auto &gc = get();
+      return std::size(gc.pending) + gc.nb_collectable;
+   }
+   // how many objects are alive (or at least not reclaimed yet)
+   static std::size_t size() noexcept {
+      return std::size(get().roots);
+   }
+   // number of candidates that makes collect() look for cycles
+   static void cycle_threshold(std::size_t n) noexcept {
+      get().nb_candidates_max = n;
+   }
+   // looks for garbage cycles, and reclaims them, right away
+   static void collect_cycles_now() {
+      get().collect_cycles();
+   }
+};
+
+struct scoped_collect {
+   collect_budget budget;
+   explicit scoped_collect(collect_budget budget = {}) noexcept : budget{ budget } {
+   }
+   scoped_collect(const scoped_collect &) = delete;
+   scoped_collect(scoped_collect &&) = delete;
+   scoped_collect& operator=(const scoped_collect &) = delete;
+   scoped_collect &operator=(scoped_collect &&) = delete;
+   ~scoped_collect() {
+      GC::get().collect(budget);
+   }
+};
+
+
+template <class T, class ... Args>
+   counting_ptr<T> gcnew(Args &&... args) {
+      return GC::get().add_root<T>(std::forward<Args>(args)...);
+   }
+
+struct NamedThing {
+   const char *name;
+   NamedThing(const char *name) : name{ name } {
+      std::cout << name << " ctor" << std::endl;
+   }
+   ~NamedThing() {
+      std::cout << name << " dtor" << std::endl;
+   }
+};
+
+auto g() {
+   auto _ = scoped_collect{};
+   [[maybe_unused]] auto p = gcnew<NamedThing>("hi");
+   auto q = gcnew<NamedThing>("there");
+   return q;
+}
+
+auto h() {
+   struct X {
+      int m() const { return 123; }
+   };
+   return gcnew<X>();
+}
+
+auto f() {
+   auto _ = scoped_collect{};
+   auto p = g();
+   std::cout << '\"' << p->name << '\"' << std::endl;
+}
+
+// a traceable type: nodes of a graph, possibly cyclic
+struct Node {
+   int value;
+   std::vector<counting_ptr<Node>> out;
+   explicit Node(int value) : value{ value } {
+   }
+   template <class F>
+      void trace(F f) {
+         for (auto &p : out)
+            f(p);
+      }
+};
+
+// nb rings of n nodes each, unreachable once this returns
+void make_rings(int nb, int n) {
+   for (int i = 0; i != nb; ++i) {
+      auto first = gcnew<Node>(0);
+      auto cur = first;
+      for (int j = 1; j != n; ++j) {
+         auto next = gcnew<Node>(j);
+         cur->out.push_back(next);
+         cur = next;
+      }
+      cur->out.push_back(first); // closes the ring
+   }
+}
+
+int main() {
+   using namespace std;
+   cout << "Pre" << endl;
+   f();
+   {
+      auto _ = scoped_collect{};
+      auto kept = gcnew<Node>(-1);
+      make_rings(10'000, 5);
+      // a ring still referenced from outside must survive
+      auto a = gcnew<Node>(1), b = gcnew<Node>(2);
+      a->out.push_back(b);
+      b->out.push_back(a);
+      kept->out.push_back(a);
+      cout << GC::size() << " objects before collecting cycles" << endl;
+      GC::collect_cycles_now();
+      cout << GC::size() << " objects after collecting cycles" << endl;
+      cout << kept->out[0]->out[0]->value << endl;
+   }
+   {
+      auto _ = scoped_collect{};
+   }
+   // a and b still reference each other, until cycles are looked for
+   cout << GC::size() << " objects after dropping the last references" << endl;
+   // collect() looks for cycles by itself past a number of candidates
+   GC::cycle_threshold(1'000);
+   for(int i = 0; i != 10; ++i) {
+      auto _ = scoped_collect{};
+      make_rings(1'000, 3);
+   }
+   cout << GC::size() << " objects after 10 scopes leaking 3'000 objects each" << endl;
+   cout << "Post" << endl;
+}